@@ -0,0 +1,116 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "appender_pool.h"
+
+#include "vanilla_chronicle.h"
+
+#include "util/spin_lock.h"
+#include "util/streamer.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+namespace
+{
+// The lane used last by this thread (shared by all the pools - it is just a hint)
+thread_local std::size_t t_lane_hint = std::numeric_limits<std::size_t>::max();
+}
+
+appender_pool::lane::lane(vanilla_chronicle & chronicle, std::int32_t writer_id)
+    : m_busy(false)
+    , m_appender(chronicle.create_appender(writer_id))
+{
+}
+
+appender_pool::lease::~lease()
+{
+    // An unfinished excerpt is abandoned - it is not visible to the tailers and will be overwritten
+    if(m_lane)
+        m_lane->m_busy.store(false, std::memory_order_release);
+}
+
+std::int64_t appender_pool::lease::finish()
+{
+    if(!m_lane)
+        throw std::logic_error("Not started");
+    m_lane->m_appender.finish();
+    const auto index = m_lane->m_appender.last_written_index();
+    m_lane->m_busy.store(false, std::memory_order_release);
+    m_lane = nullptr;
+    return index;
+}
+
+appender_pool::appender_pool(vanilla_chronicle & chronicle, std::size_t lanes, std::int32_t first_writer_id)
+    : m_next_lane(0)
+{
+    if(lanes == 0)
+        throw std::invalid_argument("An appender pool needs at least one lane");
+    if(first_writer_id < 0)
+        throw std::invalid_argument(util::streamer() << "Invalid first writer id " << first_writer_id);
+    const auto last_writer_id = static_cast<std::int64_t>(first_writer_id) + static_cast<std::int64_t>(lanes) - 1;
+    const auto & settings = chronicle.settings();
+    if(last_writer_id > settings.thread_id_mask())
+        throw std::invalid_argument(util::streamer() << "Writer ids [" << first_writer_id << ", " << last_writer_id << "] do not fit "
+                                                     << settings.thread_id_bits() << " thread id bits - raise"
+                                                     << " vanilla_chronicle_settings::thread_id_bits() to at least "
+                                                     << (64 - __builtin_clzll(static_cast<unsigned long long>(last_writer_id))));
+
+    m_lanes.reserve(lanes);
+    for(std::size_t i = 0; i != lanes; ++i)
+        m_lanes.emplace_back(new lane(chronicle, first_writer_id + static_cast<std::int32_t>(i)));
+}
+
+appender_pool::lease appender_pool::start_excerpt(std::int32_t capacity)
+{
+    lease l(acquire());
+    if(!l.appender().start_excerpt(capacity))
+    {
+        l.m_lane->m_busy.store(false, std::memory_order_release);
+        l.m_lane = nullptr;
+    }
+    return l;
+}
+
+appender_pool::lane * appender_pool::acquire()
+{
+    if(t_lane_hint == std::numeric_limits<std::size_t>::max())
+        t_lane_hint = m_next_lane.fetch_add(1, std::memory_order_relaxed);
+
+    const auto count = m_lanes.size();
+    util::default_backoff<5> backoff;
+    while(true)
+    {
+        const auto first = t_lane_hint % count;
+        for(std::size_t i = 0; i != count; ++i)
+        {
+            const auto n = (first + i) % count;
+            auto & l = *m_lanes[n];
+            if(!l.m_busy.load(std::memory_order_relaxed) && !l.m_busy.exchange(true, std::memory_order_acquire))
+            {
+                t_lane_hint = n;
+                return &l;
+            }
+        }
+        backoff();
+    }
+}
+
+}
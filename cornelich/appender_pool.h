@@ -0,0 +1,115 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_appender.h"
+
+#include <boost/config.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace cornelich
+{
+
+class vanilla_chronicle;
+
+/**
+ * A pool of appenders (lanes) that can be shared by tasks which migrate between threads.
+ *
+ * Every lane owns an excerpt_appender with a fixed writer id (first_writer_id + lane number),
+ * so handing a lane over to a different thread does not reset its regions or rescan the data
+ * files - the excerpt simply continues in the data file of the lane.
+ *
+ * Lanes are claimed without locking: start_excerpt() first tries the lane used last by the calling
+ * thread and then the remaining ones. The lane stays claimed until the returned lease is finished.
+ * If all the lanes are busy start_excerpt() backs off and retries.
+ */
+class appender_pool
+{
+    struct lane
+    {
+        lane(vanilla_chronicle & chronicle, std::int32_t writer_id);
+
+        std::atomic<bool> m_busy;
+        excerpt_appender m_appender;
+    };
+
+public:
+    /// An excerpt started on one of the lanes. The lane is released by finish() or by the destructor.
+    class lease
+    {
+    public:
+        lease(lease && other) noexcept : m_lane(other.m_lane) { other.m_lane = nullptr; }
+        ~lease();
+
+        lease(const lease &) = delete;
+        lease & operator=(const lease &) = delete;
+
+        /// False if the excerpt has been dropped (see excerpt_appender::max_lead()) - the lane is released then
+        explicit operator bool() const { return m_lane != nullptr; }
+
+        /// Throws std::logic_error if the excerpt has been dropped
+        excerpt_appender & appender()
+        {
+            if(BOOST_UNLIKELY(!m_lane))
+                throw std::logic_error("Not started");
+            return m_lane->m_appender;
+        }
+
+        util::buffer_view & buffer() { return appender().buffer(); }
+
+        template <typename T>
+        void write(T val) { appender().write(val); }
+        template <typename T, typename WRITER>
+        void write(T && val, WRITER && wrt) { appender().write(std::forward<T>(val), std::forward<WRITER>(wrt)); }
+
+        /// Commit the excerpt and release the lane. Return the index of the excerpt.
+        std::int64_t finish();
+
+    private:
+        friend class appender_pool;
+        explicit lease(lane * l) : m_lane(l) {}
+
+        lane * m_lane;
+    };
+
+    /// Create a pool with the given number of lanes using writer ids [first_writer_id, first_writer_id + lanes).
+    /// The ids are claimed exclusively (see excerpt_appender) - start at vanilla_chronicle::first_writer_id()
+    /// and keep the ranges of the pools and processes sharing the chronicle apart. The last id must fit
+    /// vanilla_chronicle_settings::thread_id_mask() - raise thread_id_bits() where pid_max is 65536 or more.
+    appender_pool(vanilla_chronicle & chronicle, std::size_t lanes, std::int32_t first_writer_id);
+
+    std::size_t lanes() const { return m_lanes.size(); }
+
+    /// Claim a lane and start an excerpt with the given capacity on it. Check the lease - the appender
+    /// of the lane drops the excerpt when its max_lead() is exceeded.
+    lease start_excerpt(std::int32_t capacity);
+
+private:
+    lane * acquire();
+
+    std::vector<std::unique_ptr<lane>> m_lanes;
+    std::atomic<std::size_t> m_next_lane;
+};
+
+}
@@ -0,0 +1,187 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "async_appender.h"
+
+#include "vanilla_chronicle.h"
+
+#include "util/spin_lock.h"
+#include "util/streamer.h"
+
+#include <stdexcept>
+
+namespace cornelich
+{
+
+async_appender::excerpt::~excerpt()
+{
+    // Release the slot, otherwise the journaling thread would wait for it forever
+    if(m_data)
+        m_ring->publish(m_sequence, -1);
+}
+
+std::uint64_t async_appender::excerpt::finish()
+{
+    if(!m_data)
+        throw std::logic_error("Not started");
+    if(m_position > m_limit)
+        throw std::logic_error(util::streamer() << "Excerpt overflow: " << m_position << " > " << m_limit);
+    m_ring->publish(m_sequence, m_position);
+    m_data = nullptr;
+    return m_sequence;
+}
+
+async_appender::async_appender(vanilla_chronicle & chronicle,
+                               std::size_t capacity,
+                               std::int32_t max_excerpt_size,
+                               full_policy policy,
+                               callback_t callback,
+                               std::size_t batch_size)
+    : m_chronicle(chronicle)
+    , m_ring(capacity, max_excerpt_size)
+    , m_policy(policy)
+    , m_callback(std::move(callback))
+    , m_batch_size(batch_size ? batch_size : 1)
+    , m_running(true)
+    , m_written(0)
+    , m_dropped(0)
+    , m_last_written_index(-1)
+    , m_failed(false)
+    , m_thread(&async_appender::run, this)
+{
+}
+
+async_appender::~async_appender()
+{
+    m_running.store(false, std::memory_order_release);
+    m_thread.join();
+}
+
+async_appender::excerpt async_appender::start_excerpt(std::int32_t capacity)
+{
+    if(BOOST_UNLIKELY(capacity > m_ring.slot_size()))
+        throw std::invalid_argument(util::streamer() << "Excerpt capacity " << capacity << " exceeds " << m_ring.slot_size());
+    check_failed();
+
+    std::uint64_t sequence = 0;
+    auto * data = m_ring.claim(sequence);
+    while(BOOST_UNLIKELY(!data))
+    {
+        // Nobody would ever release a slot
+        check_failed();
+        switch(m_policy)
+        {
+        case full_policy::spin:
+            util::wait(1);
+            break;
+        case full_policy::yield:
+            std::this_thread::yield();
+            break;
+        case full_policy::drop:
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return excerpt(&m_ring, nullptr, 0, 0);
+        }
+        data = m_ring.claim(sequence);
+    }
+    return excerpt(&m_ring, data, sequence, capacity);
+}
+
+void async_appender::flush() const
+{
+    const auto target = m_ring.published();
+    while(m_ring.consumed() < target)
+    {
+        check_failed();
+        std::this_thread::yield();
+    }
+    check_failed();
+}
+
+void async_appender::check_failed() const
+{
+    if(BOOST_UNLIKELY(m_failed.load(std::memory_order_acquire)))
+        std::rethrow_exception(m_error);
+}
+
+void async_appender::run()
+{
+    try
+    {
+        journal();
+    }
+    catch(...)
+    {
+        m_error = std::current_exception();
+        m_failed.store(true, std::memory_order_release);
+    }
+}
+
+void async_appender::journal()
+{
+    auto appender = m_chronicle.create_appender();
+    util::default_backoff<5> backoff;
+    while(true)
+    {
+        const auto running = m_running.load(std::memory_order_acquire);
+        std::size_t count = 0;
+        std::uint64_t sequence = 0;
+        std::int32_t length = 0;
+        const std::uint8_t * data = nullptr;
+        while(count != m_batch_size && (data = m_ring.peek(sequence, length)))
+        {
+            if(BOOST_UNLIKELY(length < 0))
+            {
+                // Abandoned excerpt
+                m_ring.pop();
+                continue;
+            }
+            // The appender is private and never bounded by max_lead() - just in case it is, count the drop
+            if(BOOST_UNLIKELY(!appender.start_excerpt(length)))
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                m_ring.pop();
+                continue;
+            }
+            std::memcpy(appender.buffer().data(), data, static_cast<std::size_t>(length));
+            appender.buffer().position() = length;
+            appender.finish();
+            m_ring.pop();
+            ++count;
+
+            if(m_callback)
+                m_callback(sequence, appender.last_written_index());
+        }
+
+        if(count)
+        {
+            m_last_written_index.store(appender.last_written_index(), std::memory_order_release);
+            m_written.fetch_add(count, std::memory_order_release);
+            backoff = util::default_backoff<5>();
+        }
+        else if(!running)
+        {
+            // Nothing left and nothing more is coming
+            break;
+        }
+        else
+        {
+            backoff();
+        }
+    }
+}
+
+}
@@ -0,0 +1,190 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "util/mpsc_ring.h"
+#include "util/streamer.h"
+
+#include <boost/config.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cornelich
+{
+
+class vanilla_chronicle;
+
+/**
+ * An appender that takes the chronicle writes off the producer threads.
+ *
+ * Producers encode excerpts into a bounded in-memory MPSC ring. A dedicated journaling thread drains
+ * the ring in batches and writes every excerpt into the chronicle with a regular excerpt_appender.
+ * The chronicle index assigned to an excerpt is reported through the (optional) callback, which is
+ * invoked on the journaling thread with the sequence number returned by excerpt::finish().
+ *
+ * An exception on the journaling thread (from the chronicle or from the callback) stops it; the error is
+ * rethrown by every later start_excerpt() and flush().
+ */
+class async_appender
+{
+public:
+    /// What start_excerpt() does when the ring is full
+    enum class full_policy
+    {
+        spin,   ///< busy-spin until a slot is released
+        yield,  ///< yield the CPU until a slot is released
+        drop    ///< give up - start_excerpt() returns an invalid excerpt
+    };
+
+    /// Callback invoked on the journaling thread: (sequence, chronicle index)
+    using callback_t = std::function<void(std::uint64_t, std::int64_t)>;
+
+    /// An excerpt being encoded into a ring slot
+    class excerpt
+    {
+    public:
+        excerpt(excerpt && other) noexcept
+            : m_ring(other.m_ring), m_data(other.m_data), m_sequence(other.m_sequence), m_position(other.m_position), m_limit(other.m_limit)
+        {
+            other.m_data = nullptr;
+        }
+        /// An excerpt that was never finished is skipped by the journaling thread
+        ~excerpt();
+        excerpt(const excerpt &) = delete;
+        excerpt & operator=(const excerpt &) = delete;
+
+        /// False if the ring was full and the policy was full_policy::drop
+        explicit operator bool() const { return m_data != nullptr; }
+
+        std::uint8_t * data() { return m_data; }
+        std::int32_t position() const { return m_position; }
+        std::int32_t limit() const { return m_limit; }
+
+        /// Throw std::logic_error when writing past limit() - the slot next to this one would get overwritten
+        template <typename T>
+        void write(T val);
+        /// The writer must stay within limit() - an overflow is only detected afterwards
+        template <typename T, typename WRITER>
+        void write(T && val, WRITER && wrt);
+
+        /// Publish the excerpt to the journaling thread. Return its sequence number.
+        std::uint64_t finish();
+
+    private:
+        friend class async_appender;
+        excerpt(util::mpsc_ring * ring, std::uint8_t * data, std::uint64_t sequence, std::int32_t limit)
+            : m_ring(ring), m_data(data), m_sequence(sequence), m_position(0), m_limit(limit) {}
+
+        util::mpsc_ring * m_ring;
+        std::uint8_t * m_data;
+        std::uint64_t m_sequence;
+        std::int32_t m_position;
+        std::int32_t m_limit;
+    };
+
+    /**
+     * @param chronicle The chronicle to write to
+     * @param capacity Number of excerpts the ring can hold (must be a power of 2)
+     * @param max_excerpt_size Maximum size of a single excerpt
+     * @param policy What to do when the ring is full
+     * @param callback Invoked with (sequence, index) once an excerpt has been written to the chronicle
+     * @param batch_size Maximum number of excerpts written by the journaling thread in one go
+     */
+    async_appender(vanilla_chronicle & chronicle,
+                   std::size_t capacity = 4096,
+                   std::int32_t max_excerpt_size = 1024,
+                   full_policy policy = full_policy::spin,
+                   callback_t callback = callback_t(),
+                   std::size_t batch_size = 256);
+
+    /// Write out all the published excerpts and stop the journaling thread
+    ~async_appender();
+
+    async_appender(const async_appender &) = delete;
+    async_appender & operator=(const async_appender &) = delete;
+
+    /**
+     * Claim a ring slot for an excerpt of up to capacity bytes. Thread-safe.
+     * Rethrows the error which has stopped the journaling thread (if any).
+     */
+    excerpt start_excerpt(std::int32_t capacity);
+
+    /**
+     * Wait until the excerpts finished so far have been written to the chronicle. The journaling thread
+     * writes them in the order of start_excerpt(), so the wait stops short of the first excerpt that is
+     * still open (e.g. by the calling thread) - the ones finished behind it follow once it is finished.
+     * Rethrows the error which has stopped the journaling thread (if any).
+     */
+    void flush() const;
+
+    /// Number of excerpts written to the chronicle so far
+    std::uint64_t written() const { return m_written.load(std::memory_order_acquire); }
+    /// Number of excerpts dropped because the ring was full (or the chronicle appender dropped them)
+    std::uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    /// The last chronicle index written by the journaling thread
+    std::int64_t last_written_index() const { return m_last_written_index.load(std::memory_order_acquire); }
+
+private:
+    void run();
+    void journal();
+    /// Rethrow the error which has stopped the journaling thread
+    void check_failed() const;
+
+    vanilla_chronicle & m_chronicle;
+    util::mpsc_ring m_ring;
+    const full_policy m_policy;
+    const callback_t m_callback;
+    const std::size_t m_batch_size;
+
+    std::atomic<bool> m_running;
+    std::atomic<std::uint64_t> m_written;
+    std::atomic<std::uint64_t> m_dropped;
+    std::atomic<std::int64_t> m_last_written_index;
+    /// Set once the journaling thread has stopped on m_error
+    std::atomic<bool> m_failed;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+};
+
+template<typename T>
+BOOST_FORCEINLINE void async_appender::excerpt::write(T val)
+{
+    static_assert(std::is_pod<T>::value, "async_appender::excerpt::write(): POD expected for T");
+    if(BOOST_UNLIKELY(m_position + static_cast<std::int32_t>(sizeof(T)) > m_limit))
+        throw std::logic_error(util::streamer() << "Excerpt overflow: " << m_position + sizeof(T) << " > " << m_limit);
+    std::memcpy(m_data + m_position, &val, sizeof(T));
+    m_position += static_cast<std::int32_t>(sizeof(T));
+}
+
+template <typename T, typename WRITER>
+BOOST_FORCEINLINE void async_appender::excerpt::write(T && val, WRITER && wrt)
+{
+    wrt(m_data, m_position, std::forward<T>(val));
+    if(BOOST_UNLIKELY(m_position > m_limit))
+        throw std::logic_error(util::streamer() << "Excerpt overflow: " << m_position << " > " << m_limit);
+}
+
+}
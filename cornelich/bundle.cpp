@@ -0,0 +1,213 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "bundle.h"
+
+#include "vanilla_chronicle.h"
+
+#include "util/streamer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+bundle_appender::bundle_appender(vanilla_chronicle & chronicle, std::int32_t bundle_capacity, std::int32_t max_messages)
+    : m_appender(chronicle.create_appender())
+    , m_bundle_capacity(bundle_capacity)
+    , m_max_messages(max_messages > 0 ? max_messages : 1)
+    , m_open(false)
+    , m_count(0)
+    , m_message_offset(-1)
+    , m_message_limit(0)
+{
+}
+
+bundle_appender::~bundle_appender()
+{
+    try
+    {
+        if(m_message_offset >= 0)
+        {
+            // Drop the unfinished message
+            m_appender.buffer().position() = m_message_offset;
+            m_message_offset = -1;
+        }
+        flush();
+    }
+    catch(...)
+    {
+    }
+}
+
+void bundle_appender::start_excerpt(std::int32_t capacity)
+{
+    if(capacity > BUNDLE_MAX_MESSAGE_SIZE)
+        throw std::invalid_argument(util::streamer() << "Message capacity " << capacity << " exceeds " << BUNDLE_MAX_MESSAGE_SIZE);
+    if(m_message_offset >= 0)
+        throw std::logic_error("A message is in progress");
+
+    auto & buffer = m_appender.buffer();
+    if(m_open && buffer.limit() - buffer.position() < capacity + 2)
+        flush();
+
+    if(!m_open)
+    {
+        // The appender is private and never bounded by max_lead() - it has no reason to drop the bundle
+        if(!m_appender.start_excerpt(std::max(m_bundle_capacity, capacity + 2 + 4)))
+            throw std::logic_error("The bundle has been dropped");
+        m_appender.write(BUNDLE_MAGIC);
+        m_open = true;
+    }
+
+    m_message_offset = buffer.position();
+    m_message_limit = m_message_offset + 2 + capacity;
+    buffer.position() += 2;
+}
+
+void bundle_appender::finish()
+{
+    if(m_message_offset < 0)
+        throw std::logic_error("Not started");
+
+    auto & buffer = m_appender.buffer();
+    if(buffer.position() > m_message_limit)
+        throw std::logic_error(util::streamer() << "Message overflow: " << buffer.position() - m_message_offset - 2
+                                                << " > " << m_message_limit - m_message_offset - 2);
+
+    const auto length = static_cast<std::uint16_t>(buffer.position() - m_message_offset - 2);
+    std::memcpy(buffer.data() + m_message_offset, &length, sizeof(length));
+    m_message_offset = -1;
+
+    if(++m_count == m_max_messages)
+        flush();
+}
+
+void bundle_appender::flush()
+{
+    if(m_message_offset >= 0)
+        throw std::logic_error("A message is in progress");
+    if(!m_open)
+        return;
+    if(m_count)
+        m_appender.finish();
+    m_open = false;
+    m_count = 0;
+}
+
+bundle_tailer::bundle_tailer(vanilla_chronicle & chronicle, framing f)
+    : m_tailer(chronicle.create_tailer())
+    , m_framing(f)
+    , m_index(-1)
+    , m_sub_index(-1)
+    , m_next_offset(0)
+    , m_buffer(m_index)
+{
+}
+
+bundle_tailer & bundle_tailer::to_start()
+{
+    m_tailer.to_start();
+    m_index = m_tailer.index();
+    m_sub_index = -1;
+    m_next_offset = 0;
+    m_buffer.reset();
+    return *this;
+}
+
+bundle_tailer & bundle_tailer::to_end()
+{
+    // The messages of the last excerpt are skipped as well
+    m_tailer.to_end();
+    m_index = m_tailer.index();
+    m_sub_index = -1;
+    m_next_offset = 0;
+    m_buffer.reset();
+    return *this;
+}
+
+bool bundle_tailer::next_index()
+{
+    if(m_sub_index >= 0 && m_next_offset < m_tailer.limit())
+    {
+        load_message();
+        return true;
+    }
+
+    while(m_tailer.next_index())
+    {
+        if(load_excerpt())
+            return true;
+    }
+    return false;
+}
+
+bool bundle_tailer::index(std::int64_t index, std::int32_t sub_index)
+{
+    if(!m_tailer.index(index) || !load_excerpt())
+        return false;
+    while(m_sub_index < sub_index)
+    {
+        if(m_next_offset >= m_tailer.limit())
+            return false;
+        load_message();
+    }
+    return true;
+}
+
+bool bundle_tailer::load_excerpt()
+{
+    m_index = m_tailer.index();
+    m_sub_index = -1;
+
+    std::uint32_t magic = 0;
+    if(m_tailer.limit() >= 4)
+        std::memcpy(&magic, m_tailer.buffer().data(), sizeof(magic));
+
+    if(magic != BUNDLE_MAGIC)
+    {
+        if(m_framing == framing::bundles)
+            throw std::logic_error(util::streamer() << "Not a bundle at index " << m_index);
+
+        // A regular excerpt - a single message
+        m_sub_index = 0;
+        m_next_offset = m_tailer.limit();
+        m_buffer.reset(m_tailer.buffer().data(), 0, m_tailer.limit());
+        return true;
+    }
+
+    m_next_offset = 4;
+    if(m_next_offset >= m_tailer.limit())
+        return false;
+    load_message();
+    return true;
+}
+
+void bundle_tailer::load_message()
+{
+    auto * data = m_tailer.buffer().data();
+    std::uint16_t length = 0;
+    std::memcpy(&length, data + m_next_offset, sizeof(length));
+    if(BOOST_UNLIKELY(m_next_offset + 2 + length > m_tailer.limit()))
+        throw std::logic_error(util::streamer() << "Corrupted bundle at index " << m_index << ": message length " << length);
+    m_buffer.reset(data + m_next_offset + 2, 0, length);
+    m_next_offset += 2 + length;
+    ++m_sub_index;
+}
+
+}
@@ -0,0 +1,165 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_appender.h"
+#include "excerpt_tailer.h"
+#include "util/buffer_view.h"
+
+#include <boost/config.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace cornelich
+{
+
+class vanilla_chronicle;
+
+/**
+ * Bundles pack many small messages into a single excerpt (one index entry and one length word).
+ *
+ * Layout of a bundle excerpt:
+ *   [BUNDLE_MAGIC (4 bytes)] { [message length (2 bytes)][message] }*
+ *
+ * An ordinary payload may start with the same 4 bytes, so the magic alone cannot tell a bundle apart.
+ * A bundle_tailer therefore reads every excerpt as a bundle unless it is explicitly told that the chronicle
+ * mixes bundles with regular excerpts (see bundle_tailer::framing).
+ */
+static constexpr std::uint32_t BUNDLE_MAGIC = 0xB0DE1E5C;
+static constexpr std::int32_t BUNDLE_MAX_MESSAGE_SIZE = 0xFFFF;
+
+class bundle_appender
+{
+public:
+    /**
+     * @param chronicle The chronicle to write to
+     * @param bundle_capacity Space reserved for a bundle (a bigger one is used for a bigger message)
+     * @param max_messages Publish the bundle once it holds that many messages
+     */
+    bundle_appender(vanilla_chronicle & chronicle, std::int32_t bundle_capacity = 4096, std::int32_t max_messages = 256);
+    /// Publish the pending messages
+    ~bundle_appender();
+
+    bundle_appender(const bundle_appender &) = delete;
+    bundle_appender & operator=(const bundle_appender &) = delete;
+
+    /// Start a message of up to capacity bytes. Publishes the current bundle first if the message does not fit in it.
+    void start_excerpt(std::int32_t capacity);
+    /// Finish the message. Publishes the bundle if it is full.
+    void finish();
+    /// Publish the current bundle (if there are any messages in it)
+    void flush();
+
+    /// Number of finished messages waiting in the current bundle
+    std::int32_t pending() const { return m_count; }
+    /// Index of the last published bundle
+    std::int64_t last_written_index() const { return m_appender.last_written_index(); }
+
+    /// The buffer of the whole bundle - the current message is written at its position
+    util::buffer_view & buffer() { return m_appender.buffer(); }
+
+    template <typename T>
+    void write(T val) { m_appender.write(val); }
+    template <typename T, typename WRITER>
+    void write(T && val, WRITER && wrt) { m_appender.write(std::forward<T>(val), std::forward<WRITER>(wrt)); }
+
+private:
+    excerpt_appender m_appender;
+    const std::int32_t m_bundle_capacity;
+    const std::int32_t m_max_messages;
+
+    bool m_open;
+    std::int32_t m_count;
+    std::int32_t m_message_offset;
+    std::int32_t m_message_limit;
+};
+
+class bundle_tailer
+{
+public:
+    /// How the excerpts of the chronicle are framed
+    enum class framing
+    {
+        bundles,    ///< every excerpt is a bundle - an excerpt without BUNDLE_MAGIC is reported as corrupted
+        mixed       ///< excerpts not starting with BUNDLE_MAGIC are single messages - the regular payloads must never start with it
+    };
+
+    explicit bundle_tailer(vanilla_chronicle & chronicle, framing f = framing::bundles);
+
+    bundle_tailer(const bundle_tailer &) = delete;
+    bundle_tailer & operator=(const bundle_tailer &) = delete;
+
+    /// Index of the excerpt holding the current message
+    std::int64_t index() const { return m_index; }
+    /// Number of the current message within its excerpt
+    std::int32_t sub_index() const { return m_sub_index; }
+
+    /// Move to the given message (composite position: excerpt index, message number)
+    bool index(std::int64_t index, std::int32_t sub_index);
+
+    bundle_tailer & to_start();
+    bundle_tailer & to_end();
+
+    /// Move to the next message (from the same bundle or the next excerpt)
+    bool next_index();
+
+    util::buffer_view & buffer() { return m_buffer; }
+    const util::buffer_view & buffer() const { return m_buffer; }
+
+    std::int32_t position() const { return m_buffer.position(); }
+    std::int32_t limit() const { return m_buffer.limit(); }
+
+    template <typename T>
+    T read();
+    template <typename READER>
+    typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type read(READER && rdr);
+
+private:
+    /// Set up the first message of the current excerpt. Return false for an empty bundle.
+    bool load_excerpt();
+    /// Set up the message at m_next_offset
+    void load_message();
+
+    excerpt_tailer m_tailer;
+    const framing m_framing;
+    std::int64_t m_index;
+    std::int32_t m_sub_index;
+    std::int32_t m_next_offset;
+    util::buffer_view m_buffer;
+};
+
+template<typename T>
+BOOST_FORCEINLINE T bundle_tailer::read()
+{
+    static_assert(std::is_pod<T>::value, "bundle_tailer::read(): POD expected for T");
+    T val;
+    std::memcpy(&val, m_buffer.data() + m_buffer.position(), sizeof(T));
+    m_buffer.position() += static_cast<std::int32_t>(sizeof(T));
+    return val;
+}
+
+template <typename READER>
+BOOST_FORCEINLINE typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type bundle_tailer::read(READER && rdr)
+{
+    return rdr(m_buffer.data(), m_buffer.position());
+}
+
+}
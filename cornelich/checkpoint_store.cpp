@@ -0,0 +1,167 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "checkpoint_store.h"
+
+#include "vanilla_chronicle_settings.h"
+
+#include "util/files.h"
+#include "util/streamer.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+namespace
+{
+
+constexpr std::int32_t SLOT_SIZE = 64;
+constexpr std::int32_t STATE_OFFSET = 0;
+constexpr std::int32_t INDEX_OFFSET = 8;
+constexpr std::int32_t NAME_OFFSET = 16;
+
+enum slot_state : std::int64_t
+{
+    free_slot = 0,
+    claimed_slot = 1,
+    used_slot = 2
+};
+
+std::string checkpoint_file(const std::string & base_path)
+{
+    boost::filesystem::create_directories(base_path);
+    return (boost::filesystem::path(base_path) / CHECKPOINT_FILE_NAME).string();
+}
+
+}
+
+constexpr std::int32_t checkpoint_store::SLOT_COUNT;
+constexpr std::size_t checkpoint_store::MAX_NAME_LENGTH;
+
+checkpoint_store::checkpoint_store(const std::string & base_path)
+    : m_region(checkpoint_file(base_path), SLOT_COUNT * SLOT_SIZE, 0)
+{
+}
+
+void checkpoint_store::store(const std::string & name, std::int64_t index)
+{
+    const auto slot = slot_for(name, true);
+    if(slot < 0)
+        throw std::runtime_error(util::streamer() << "No room for checkpoint '" << name << "' in " << m_region.path());
+    m_region.write_ordered64(slot + INDEX_OFFSET, index);
+}
+
+std::int64_t checkpoint_store::load(const std::string & name)
+{
+    const auto slot = slot_for(name, false);
+    return slot < 0 ? -1 : m_region.read_ordered64(slot + INDEX_OFFSET);
+}
+
+bool checkpoint_store::remove(const std::string & name)
+{
+    const auto slot = slot_for(name, false);
+    if(slot < 0)
+        return false;
+    {
+        std::lock_guard<util::spin_lock> lk(m_lock);
+        m_slots.erase(name);
+    }
+    return m_region.cas64(slot + STATE_OFFSET, used_slot, free_slot);
+}
+
+std::int64_t checkpoint_store::min_index() const
+{
+    auto result = std::numeric_limits<std::int64_t>::max();
+    for(std::int32_t slot = 0; slot != SLOT_COUNT * SLOT_SIZE; slot += SLOT_SIZE)
+    {
+        if(m_region.read_ordered64(slot + STATE_OFFSET) != used_slot)
+            continue;
+        const auto index = m_region.read_ordered64(slot + INDEX_OFFSET);
+        if(index >= 0)
+            result = std::min(result, index);
+    }
+    return result == std::numeric_limits<std::int64_t>::max() ? -1 : result;
+}
+
+std::int32_t checkpoint_store::slot_for(const std::string & name, bool create)
+{
+    if(name.empty() || name.size() > MAX_NAME_LENGTH)
+        throw std::invalid_argument(util::streamer() << "Invalid checkpoint name: '" << name << "'");
+
+    {
+        // Only the cache is guarded - the other threads must not spin while this one waits for the file lock
+        std::lock_guard<util::spin_lock> lk(m_lock);
+        auto it = m_slots.find(name);
+        // Another process may have removed it (and reused the slot for another name)
+        if(it != m_slots.end() && slot_holds(it->second, name))
+            return it->second;
+    }
+
+    auto slot = find_slot(name);
+    if(slot < 0 && create)
+    {
+        // Adding the name is serialized between the processes and the threads (the lock goes away with
+        // a dead process) - so it is looked up again and added only by whoever comes first
+        const auto adding = util::file_lock::lock(m_region.path() + CHECKPOINT_LOCK_FILE_SUFFIX);
+        slot = find_slot(name);
+        for(std::int32_t candidate = 0; slot < 0 && candidate != SLOT_COUNT * SLOT_SIZE; candidate += SLOT_SIZE)
+        {
+            if(!m_region.cas64(candidate + STATE_OFFSET, free_slot, claimed_slot))
+                continue;
+            auto * slot_name = reinterpret_cast<char *>(m_region.data() + candidate + NAME_OFFSET);
+            std::memset(slot_name, 0, SLOT_SIZE - NAME_OFFSET);
+            std::memcpy(slot_name, name.data(), name.size());
+            m_region.write_ordered64(candidate + INDEX_OFFSET, -1);
+            m_region.write_ordered64(candidate + STATE_OFFSET, used_slot);
+            slot = candidate;
+        }
+    }
+
+    if(slot >= 0)
+    {
+        std::lock_guard<util::spin_lock> lk(m_lock);
+        m_slots[name] = slot;
+    }
+    return slot;
+}
+
+std::int32_t checkpoint_store::find_slot(const std::string & name) const
+{
+    for(std::int32_t slot = 0; slot != SLOT_COUNT * SLOT_SIZE; slot += SLOT_SIZE)
+    {
+        if(slot_holds(slot, name))
+            return slot;
+    }
+    return -1;
+}
+
+bool checkpoint_store::slot_holds(std::int32_t slot, const std::string & name) const
+{
+    if(m_region.read_ordered64(slot + STATE_OFFSET) != used_slot)
+        return false;
+    const auto * slot_name = reinterpret_cast<const char *>(m_region.data() + slot + NAME_OFFSET);
+    return !std::strncmp(slot_name, name.c_str(), SLOT_SIZE - NAME_OFFSET);
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "region.h"
+#include "util/spin_lock.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace cornelich
+{
+
+/**
+ * Named consumer positions (checkpoints) kept in the memory mapped file 'checkpoints' in the chronicle
+ * base path - shared by all the processes using the chronicle.
+ *
+ * The file is a table of fixed-size slots: [state:8][index:8][name:48]. A checkpoint is stored with an
+ * ordered write into its slot (found once per name and remembered), so storing and loading is O(1).
+ * Stores are not synced to the disk one by one - flush() writes all of them out at once.
+ * New names are added under an exclusive lock on 'checkpoints.lock', so a name never gets two slots.
+ */
+class checkpoint_store
+{
+public:
+    /// Number of checkpoints the file can hold
+    static constexpr std::int32_t SLOT_COUNT = 1024;
+    /// Maximum length of a checkpoint name
+    static constexpr std::size_t MAX_NAME_LENGTH = 47;
+
+    explicit checkpoint_store(const std::string & base_path);
+
+    checkpoint_store(const checkpoint_store &) = delete;
+    checkpoint_store & operator=(const checkpoint_store &) = delete;
+
+    /// Store the position of the named consumer
+    void store(const std::string & name, std::int64_t index);
+    /// Return the stored position of the named consumer or -1 if there is none
+    std::int64_t load(const std::string & name);
+    /// Remove the named checkpoint. Return false if there was none.
+    bool remove(const std::string & name);
+
+    /// The position of the slowest consumer (-1 if there are no checkpoints)
+    std::int64_t min_index() const;
+
+    /// Write the checkpoints out to the disk (one msync for all of them) - wait for the write unless async
+    void flush(bool async = false) { m_region.flush(async); }
+
+private:
+    /// Return the offset of the slot of the named checkpoint - claim a new one if create is set.
+    /// -1 if there is no such checkpoint (or no free slot left).
+    std::int32_t slot_for(const std::string & name, bool create);
+    /// Look for the slot of the named checkpoint in the file
+    std::int32_t find_slot(const std::string & name) const;
+    /// Whether the slot is in use by the named checkpoint
+    bool slot_holds(std::int32_t slot, const std::string & name) const;
+
+    region m_region;
+    /// Guards m_slots only - never held while waiting for the file lock of adding a name
+    util::spin_lock m_lock;
+    std::unordered_map<std::string, std::int32_t> m_slots;
+};
+
+}
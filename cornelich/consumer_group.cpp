@@ -0,0 +1,161 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "consumer_group.h"
+
+#include "vanilla_chronicle.h"
+
+#include "util/streamer.h"
+#include "util/thread.h"
+
+#include <boost/filesystem.hpp>
+
+#include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
+
+namespace cornelich
+{
+
+namespace
+{
+
+// The consumer file layout: the state of the file, then the last claimed index
+constexpr std::int32_t STATE_OFFSET = 0;
+constexpr std::int32_t CURSOR_OFFSET = 8;
+constexpr std::uint32_t CONSUMER_FILE_SIZE = 64;
+
+// Initializing is tagged with the process id of the initializer: (pid << 2) | initializing
+enum state : std::int64_t
+{
+    created = 0,
+    initializing = 1,
+    ready = 2
+};
+
+constexpr std::int32_t initializer_of(std::int64_t state) { return static_cast<std::int32_t>(state >> 2); }
+
+std::string consumer_file(const vanilla_chronicle & chronicle, const std::string & name)
+{
+    if(name.empty() || name.find('/') != std::string::npos)
+        throw std::invalid_argument(util::streamer() << "Invalid consumer group name: '" << name << "'");
+    boost::filesystem::create_directories(chronicle.settings().path());
+    return (boost::filesystem::path(chronicle.settings().path()) / (CONSUMER_FILE_NAME_PREFIX + name)).string();
+}
+
+}
+
+consumer_group::consumer_group(vanilla_chronicle & chronicle, const std::string & name, start_position start)
+    : m_name(name)
+    , m_cursor(consumer_file(chronicle, name), CONSUMER_FILE_SIZE, 0)
+    , m_tailer(chronicle.create_tailer())
+    , m_claimed(0)
+{
+    // Only the index entries are needed to find the next excerpt - the data is read for the claimed one only
+    m_tailer.lazy_data(true);
+
+    const std::int64_t initializing_state = (static_cast<std::int64_t>(::getpid()) << 2) | initializing;
+    while(true)
+    {
+        const auto current = m_cursor.read_ordered64(STATE_OFFSET);
+        if(current == ready)
+            break;
+        if(current == created)
+        {
+            if(!m_cursor.cas64(STATE_OFFSET, created, initializing_state))
+                continue;
+            try
+            {
+                initialize(chronicle, start);
+            }
+            catch(...)
+            {
+                // Let another member try
+                m_cursor.write_ordered64(STATE_OFFSET, created);
+                throw;
+            }
+            m_cursor.write_ordered64(STATE_OFFSET, ready);
+            break;
+        }
+        // The initializer died half way - start over (the cursor gets written again)
+        if(!util::process_alive(initializer_of(current)))
+            m_cursor.cas64(STATE_OFFSET, current, created);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void consumer_group::initialize(vanilla_chronicle & chronicle, start_position start)
+{
+    std::int64_t cursor = -1;
+    if(start == start_position::end)
+    {
+        cursor = chronicle.last_index();
+        // The last index file may have no entries yet
+        if(cursor >= 0 && !m_tailer.index(cursor))
+            --cursor;
+    }
+    m_cursor.write_ordered64(CURSOR_OFFSET, cursor);
+}
+
+std::int64_t consumer_group::group_index() const
+{
+    return m_cursor.read_ordered64(CURSOR_OFFSET);
+}
+
+bool consumer_group::next_index()
+{
+    auto last = m_cursor.read_ordered64(CURSOR_OFFSET);
+    while(true)
+    {
+        if(!next_after(last))
+            return false;
+        // Only published excerpts are claimed, so a member never waits for an excerpt that is not there
+        // (e.g. one past the end of a cycle)
+        const auto index = m_tailer.index();
+        if(m_cursor.cas64(CURSOR_OFFSET, last, index))
+        {
+            ++m_claimed;
+            return true;
+        }
+        last = m_cursor.read_ordered64(CURSOR_OFFSET);
+    }
+}
+
+bool consumer_group::next_after(std::int64_t index)
+{
+    // Usually the tailer is where the group is (this member claimed the last excerpt)
+    if(index < 0)
+    {
+        m_tailer.to_start();
+        return m_tailer.next_index();
+    }
+    if(m_tailer.index() == index || m_tailer.index(index))
+        return m_tailer.next_index();
+
+    // The index is gone (or has not been published) - look for the first excerpt after it
+    m_tailer.to_start();
+    while(m_tailer.next_index())
+    {
+        if(m_tailer.index() > index)
+            return true;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,86 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_tailer.h"
+#include "region.h"
+
+#include <cstdint>
+#include <string>
+
+namespace cornelich
+{
+
+class vanilla_chronicle;
+
+/**
+ * A member of a consumer group - the excerpts of the chronicle are shared out among the members of
+ * the group instead of every member seeing all of them.
+ *
+ * The members (in one or several processes) share a claim cursor - the last claimed index - kept in
+ * the memory mapped file consumer-<name> in the chronicle base path. A member claims the next published
+ * excerpt after the cursor by moving the cursor onto it with a CAS, so every excerpt is claimed by
+ * exactly one member. An excerpt claimed by a member that dies before processing it is not handed out
+ * again.
+ *
+ * The first member initializes the cursor (see start_position). The others wait for it - unless its
+ * process is gone, in which case one of them takes the initialization over.
+ */
+class consumer_group
+{
+public:
+    /// Where a new group (one without the consumer file yet) starts
+    enum class start_position
+    {
+        start,  ///< with the first excerpt in the chronicle
+        end     ///< with the first excerpt written after the group has been created
+    };
+
+    consumer_group(vanilla_chronicle & chronicle, const std::string & name, start_position start = start_position::start);
+
+    consumer_group(const consumer_group &) = delete;
+    consumer_group & operator=(const consumer_group &) = delete;
+
+    const std::string & name() const { return m_name; }
+
+    /// Claim the next excerpt nobody in the group has claimed yet. Return false if there is none at the moment.
+    bool next_index();
+
+    /// Index of the excerpt claimed last by this member
+    std::int64_t index() const { return m_tailer.index(); }
+    /// The claimed excerpt (valid after next_index() has returned true)
+    excerpt_tailer & tailer() { return m_tailer; }
+
+    /// Number of excerpts claimed by this member
+    std::uint64_t claimed() const { return m_claimed; }
+    /// The index claimed last by the whole group (-1 if none)
+    std::int64_t group_index() const;
+
+private:
+    /// Set the cursor of a new group
+    void initialize(vanilla_chronicle & chronicle, start_position start);
+    /// Move the tailer onto the first published excerpt after the given index
+    bool next_after(std::int64_t index);
+
+    const std::string m_name;
+    region m_cursor;
+    excerpt_tailer m_tailer;
+    std::uint64_t m_claimed;
+};
+
+}
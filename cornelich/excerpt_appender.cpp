@@ -21,34 +21,215 @@ limitations under the License.
 #include "vanilla_utils.h"
 
 #include "util/math_util.h"
+#include "util/spin_lock.h"
 #include "util/streamer.h"
 #include "util/thread.h"
 
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 
 namespace cornelich
 {
 
+excerpt_reservation::excerpt_reservation(region_ptr data_region, std::int32_t cycle, std::int32_t thread_id, std::int32_t offset, std::int32_t capacity)
+    : m_data_region(std::move(data_region))
+    , m_cycle(cycle)
+    , m_thread_id(thread_id)
+    , m_offset(offset)
+    , m_capacity(capacity)
+    , m_index(-1)
+    , m_buffer(m_index)
+{
+    m_buffer.reset(m_data_region->data() + offset + 4, 0, capacity);
+}
+
+excerpt_reservation::excerpt_reservation(excerpt_reservation && other) noexcept
+    : m_data_region(std::move(other.m_data_region))
+    , m_cycle(other.m_cycle)
+    , m_thread_id(other.m_thread_id)
+    , m_offset(other.m_offset)
+    , m_capacity(other.m_capacity)
+    , m_index(other.m_index)
+    , m_buffer(m_index)
+{
+    // The buffer refers to the index of its owner - rebind it
+    m_buffer.reset(other.m_buffer.data(), other.m_buffer.position(), other.m_buffer.limit());
+    other.m_buffer.reset();
+}
+
+namespace
+{
+
+std::unique_ptr<util::file_lock> claim_writer_id(vanilla_chronicle & chronicle, std::int32_t writer_id)
+{
+    if(writer_id < 0)
+        return {};
+
+    const auto & settings = chronicle.settings();
+    if(writer_id < chronicle.first_writer_id() || (writer_id & settings.thread_id_mask()) != writer_id)
+        throw std::invalid_argument(util::streamer() << "Writer id " << writer_id << " is not in [" << chronicle.first_writer_id()
+                                                     << ", " << settings.thread_id_mask() << "] - the ids below are native thread ids"
+                                                     << " and the ids above need more than " << settings.thread_id_bits() << " thread id bits");
+
+    boost::filesystem::create_directories(settings.path());
+    auto lock = util::file_lock::try_lock(settings.path() + "/" + WRITER_LOCK_FILE_NAME_PREFIX + std::to_string(writer_id));
+    if(!lock)
+        throw std::runtime_error(util::streamer() << "Writer id " << writer_id << " is in use");
+    return lock;
+}
+
+void check_shared_header(const vanilla_chronicle & chronicle)
+{
+    // The readers watching the header would never see the excerpts of this appender
+    const auto & settings = chronicle.settings();
+    if(!settings.shared_header() && boost::filesystem::exists(boost::filesystem::path(settings.path()) / HEADER_FILE_NAME))
+        throw std::logic_error(util::streamer() << "The chronicle " << settings.path() << " has a shared header"
+                                                << " - the appenders have to be opened with shared_header(true)");
+}
+
+}
+
 excerpt_appender::excerpt_appender(vanilla_chronicle & chronicle)
+    : excerpt_appender(chronicle, -1)
+{
+}
+
+excerpt_appender::excerpt_appender(vanilla_chronicle & chronicle, std::int32_t writer_id)
     : m_chronicle(chronicle)
+    , m_writer_id(writer_id)
+    , m_writer_lock(claim_writer_id(chronicle, writer_id))
     , m_index(-1)
     , m_last_cycle(-1)
     , m_last_index_file_number(-1)
     , m_last_thread_id(-1)
-    , m_last_data_file_number(-1)
     , m_finished(true)
     , m_buffer(m_index)
 {
+    check_shared_header(chronicle);
+}
+
+excerpt_appender::excerpt_appender(excerpt_appender && other) noexcept
+    : m_chronicle(other.m_chronicle)
+    , m_writer_id(other.m_writer_id)
+    , m_writer_lock(std::move(other.m_writer_lock))
+    , m_index_region(std::move(other.m_index_region))
+    , m_data_region(std::move(other.m_data_region))
+    , m_time_region(std::move(other.m_time_region))
+    , m_time_cycle(other.m_time_cycle)
+    , m_index(other.m_index)
+    , m_last_cycle(other.m_last_cycle)
+    , m_last_index_file_number(other.m_last_index_file_number)
+    , m_last_thread_id(other.m_last_thread_id)
+    , m_data_lease(std::move(other.m_data_lease))
+    , m_finished(other.m_finished)
+    , m_last_written_index(other.m_last_written_index)
+    , m_buffer(m_index)
+    , m_max_lead(other.m_max_lead)
+    , m_lead_policy(other.m_lead_policy)
+    , m_lead_callback(std::move(other.m_lead_callback))
+    , m_dropped(other.m_dropped)
+    , m_known_lead(other.m_known_lead)
+    , m_lead_written(other.m_lead_written)
+{
+    // The buffer refers to the index of its owner - rebind it
+    m_buffer.reset(other.m_buffer.data(), other.m_buffer.position(), other.m_buffer.limit());
+    other.m_buffer.reset();
+    other.m_finished = true;
 }
 
-void excerpt_appender::start_excerpt(std::int32_t capacity)
+bool excerpt_appender::start_excerpt(std::int32_t capacity)
 {
+    if(BOOST_UNLIKELY(m_max_lead > 0) && !check_lead())
+    {
+        // Whatever gets written anyway must not land in the previous (published) excerpt
+        m_buffer.reset();
+        return false;
+    }
     start_excerpt(capacity, cycle_for_now(m_chronicle.m_settings.cycle_length()));
+    return true;
+}
+
+excerpt_appender & excerpt_appender::max_lead(std::int64_t excerpts, lead_policy policy, lead_callback_t callback)
+{
+    if(policy == lead_policy::callback && !callback)
+        throw std::invalid_argument("No callback for lead_policy::callback");
+    m_max_lead = excerpts;
+    m_lead_policy = policy;
+    m_lead_callback = std::move(callback);
+    m_known_lead = -1;
+    return *this;
+}
+
+bool excerpt_appender::check_lead()
+{
+    auto lead = current_lead(false);
+    if(lead < m_max_lead)
+        return true;
+
+    switch(m_lead_policy)
+    {
+    case lead_policy::spin:
+    case lead_policy::block:
+    {
+        util::default_backoff<5> backoff;
+        while((lead = current_lead(true)) >= m_max_lead)
+        {
+            if(m_lead_policy == lead_policy::spin)
+                backoff();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+    case lead_policy::drop:
+        break;
+    case lead_policy::callback:
+        if(m_lead_callback(lead))
+            return true;
+        break;
+    }
+    ++m_dropped;
+    return false;
+}
+
+std::int64_t excerpt_appender::current_lead(bool refresh)
+{
+    auto * header = m_chronicle.header();
+    auto written = header ? header->last_index() : m_chronicle.last_written_index();
+    if(written < 0)
+        written = m_chronicle.last_index();
+    if(written < 0)
+        return -1;
+
+    // The consumers only move forward - so the lead is at most the known one plus what has been written since
+    // (as long as that is in the same cycle)
+    const auto same_cycle = util::right_shift(written ^ m_lead_written, m_chronicle.m_entries_for_cycle_bits) == 0;
+    if(!refresh && m_known_lead >= 0 && same_cycle && m_known_lead + (written - m_lead_written) < m_max_lead)
+        return m_known_lead + (written - m_lead_written);
+
+    // Without consumers the checkpoints are looked at again after max_lead excerpts
+    const auto slowest = m_chronicle.checkpoints().min_index();
+    m_lead_written = written;
+    m_known_lead = slowest < 0 ? 0 : (slowest < written ? m_chronicle.excerpts_between(slowest, written) : 0);
+    return slowest < 0 ? -1 : m_known_lead;
 }
 
 void excerpt_appender::start_excerpt(std::int32_t capacity, std::int32_t cycle)
 {
-    auto thread_id = util::get_native_thread_id();
+    prepare(capacity, cycle);
+
+    m_buffer.reset(m_data_region->data() + m_data_lease->position() + 4, 0, static_cast<std::int32_t>(capacity));
+    __builtin_prefetch(m_data_region->data() + 64, 1);
+    m_finished = false;
+}
+
+void excerpt_appender::prepare(std::int32_t capacity, std::int32_t cycle)
+{
+    auto thread_id = m_writer_id < 0 ? util::get_native_thread_id() : m_writer_id;
     assert((thread_id & m_chronicle.m_settings.thread_id_mask()) == thread_id);
 
     if (cycle != m_last_cycle)
@@ -56,6 +237,7 @@ void excerpt_appender::start_excerpt(std::int32_t capacity, std::int32_t cycle)
         m_index_region.reset();
 
         m_data_region.reset();
+        m_data_lease.reset();
 
         m_last_cycle = cycle;
         m_last_index_file_number = m_chronicle.m_index.last_index_file_number(m_last_cycle, 0);
@@ -64,23 +246,23 @@ void excerpt_appender::start_excerpt(std::int32_t capacity, std::int32_t cycle)
     else if (thread_id != m_last_thread_id)
     {
         m_data_region.reset();
+        m_data_lease.reset();
         m_last_thread_id = thread_id;
     }
 
     if (!m_data_region)
     {
-        m_last_data_file_number = m_chronicle.m_data.find_next_data_file_number(cycle, thread_id);
-        m_data_region = m_chronicle.m_data.data_for(cycle,thread_id, m_last_data_file_number, true);
+        m_data_lease = m_chronicle.m_data.data_for_append(cycle, thread_id, true);
+        m_data_region = m_data_lease->region();
     }
 
-    if (m_data_region->remaining() < static_cast<std::int32_t>(capacity) + 4) // +4 to store the size later on (see finish())
+    if (m_data_region->limit() - m_data_lease->position() < static_cast<std::int32_t>(capacity) + 4) // +4 to store the size later on (see finish())
     {
-        m_data_region = m_chronicle.m_data.data_for(cycle, thread_id, ++m_last_data_file_number, true);
+        // Release the full file first - it is not worth resuming anyway
+        m_data_lease.reset();
+        m_data_lease = m_chronicle.m_data.data_for_append(cycle, thread_id, false);
+        m_data_region = m_data_lease->region();
     }
-
-    m_buffer.reset(m_data_region->data() + m_data_region->position() + 4, 0, static_cast<std::int32_t>(capacity));
-    __builtin_prefetch(m_data_region->data() + 64, 1);
-    m_finished = false;
 }
 
 void excerpt_appender::finish()
@@ -95,8 +277,67 @@ void excerpt_appender::finish()
 
     m_data_region->write_ordered32(static_cast<std::int32_t>(m_buffer.data() - m_data_region->data() - 4), length);
 
-    const auto data_offset = m_data_region->index() * m_chronicle.m_settings.data_block_size() + (m_buffer.data() - m_data_region->data());
-    const auto index_value = (static_cast<std::int64_t>(m_last_thread_id) << m_chronicle.m_settings.index_data_offset_bits()) + data_offset;
+    publish(m_last_cycle, m_last_thread_id, *m_data_region, m_buffer.data());
+
+    m_index = m_last_written_index + 1;
+    m_data_lease->position((m_data_lease->position() + m_buffer.position() + 4 + 3) & ~3);
+    m_finished = true;
+}
+
+excerpt_reservation excerpt_appender::reserve(std::int32_t capacity)
+{
+    if(!m_finished)
+        throw std::logic_error("Cannot reserve while an excerpt is in progress");
+
+    prepare(capacity, cycle_for_now(m_chronicle.m_settings.cycle_length()));
+
+    // Mark the whole reservation as used (~capacity in the length word) so it is never mistaken
+    // for the end of the data (see vanilla_data::find_data_end) - even if it never gets committed
+    const auto offset = m_data_lease->position();
+    m_data_region->write_ordered32(offset, ~capacity);
+    m_data_lease->position((offset + capacity + 4 + 3) & ~3);
+
+    return excerpt_reservation(m_data_region, m_last_cycle, m_last_thread_id, offset, capacity);
+}
+
+std::int64_t excerpt_appender::commit(excerpt_reservation & reservation)
+{
+    if(!reservation.pending())
+        throw std::logic_error("Not reserved or already committed");
+
+    auto & r = *reservation.m_data_region;
+    const auto length = reservation.m_buffer.position();
+    if(length > reservation.m_capacity)
+        throw std::logic_error(util::streamer() << "Reservation overflow: " << length << " > " << reservation.m_capacity);
+
+    // If the excerpt turned out shorter than reserved then describe the rest as a filler
+    // (which is never indexed) first, so the length words still chain through the region
+    const auto used_end = (reservation.m_offset + 4 + length + 3) & ~3;
+    const auto reserved_end = (reservation.m_offset + 4 + reservation.m_capacity + 3) & ~3;
+    if(reserved_end - used_end >= 4)
+        r.write_ordered32(used_end, ~(reserved_end - used_end - 4));
+    r.write_ordered32(reservation.m_offset, ~length);
+
+    publish(reservation.m_cycle, reservation.m_thread_id, r, reservation.m_buffer.data());
+
+    reservation.m_index = m_last_written_index;
+    reservation.m_data_region.reset();
+    return reservation.m_index;
+}
+
+void excerpt_appender::publish(std::int32_t cycle, std::int32_t thread_id, const region & data_region, const std::uint8_t * data)
+{
+    const auto data_offset = data_region.index() * m_chronicle.m_settings.data_block_size() + (data - data_region.data());
+    const auto index_value = (static_cast<std::int64_t>(thread_id) << m_chronicle.m_settings.index_data_offset_bits()) + data_offset;
+
+    if(BOOST_UNLIKELY(cycle != m_last_cycle))
+    {
+        // A reservation made before the cycle changed
+        auto && result = m_chronicle.m_index.append(cycle, index_value, m_chronicle.m_index.last_index_file_number(cycle, 0));
+        set_last_written_index(cycle, result.first->index(), result.second);
+        record_time(cycle, result.first->index(), result.second);
+        return;
+    }
 
     auto position = m_index_region ? vanilla_index::append(*m_index_region, index_value) : -1;
     if (position < 0)
@@ -112,11 +353,7 @@ void excerpt_appender::finish()
     }
 
     set_last_written_index(m_last_cycle, m_index_region->index(), position);
-
-    m_index = m_last_written_index + 1;
-    m_data_region->position(m_data_region->position() + m_buffer.position() + 4);
-    m_data_region->align_position(4);
-    m_finished = true;
+    record_time(m_last_cycle, m_index_region->index(), position);
 }
 
 std::int64_t excerpt_appender::index_from(std::int64_t cycle, std::int64_t index_count, std::int64_t index_position) const
@@ -131,9 +368,26 @@ void excerpt_appender::set_last_written_index(std::int64_t cycle, std::int64_t i
     while(true)
     {
         std::int64_t lwi = m_chronicle.last_written_index();
-        if(lwi >= last_written_index || m_chronicle.m_last_written_index.compare_exchange_weak(lwi, last_written_index))
+        if(lwi >= last_written_index || m_chronicle.m_last_written_index->compare_exchange_weak(lwi, last_written_index))
             break;
     }
+    if(m_chronicle.m_header)
+        m_chronicle.m_header->committed(last_written_index);
+}
+
+void excerpt_appender::record_time(std::int32_t cycle, std::int32_t index_file_number, std::int64_t index_position)
+{
+    auto & time_index = m_chronicle.m_time_index;
+    const auto entry = index_position >> 3;
+    if(BOOST_LIKELY(!time_index.sampled(entry)))
+        return;
+
+    if(!m_time_region || m_time_cycle != cycle || m_time_region->index() != index_file_number)
+    {
+        m_time_region = time_index.time_for(cycle, index_file_number, true);
+        m_time_cycle = cycle;
+    }
+    m_time_region->write_ordered64(static_cast<std::int32_t>((entry >> time_index.interval_bits()) << 3), micros_for_now());
 }
 
 }
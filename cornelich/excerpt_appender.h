@@ -18,12 +18,16 @@ limitations under the License.
 #pragma once
 
 #include "region.h"
+#include "vanilla_data.h"
 #include "util/buffer_view.h"
+#include "util/files.h"
 
 #include <cstdint>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <type_traits>
+#include <utility>
 
 namespace cornelich
 {
@@ -31,18 +35,117 @@ namespace cornelich
 class vanilla_chronicle;
 using region_ptr = std::shared_ptr<region>;
 
+/**
+ * An excerpt reserved in a data region with excerpt_appender::reserve().
+ * It can be filled independently of other reservations (e.g. on a different thread) and
+ * becomes visible to the tailers once committed with excerpt_appender::commit().
+ */
+class excerpt_reservation
+{
+public:
+    excerpt_reservation(excerpt_reservation && other) noexcept;
+    excerpt_reservation(const excerpt_reservation &) = delete;
+    excerpt_reservation & operator=(const excerpt_reservation &) = delete;
+
+    /// Index assigned on commit (-1 before)
+    std::int64_t index() const { return m_index; }
+    /// Whether the reservation is still waiting for commit
+    bool pending() const { return !!m_data_region; }
+
+    util::buffer_view & buffer() { return m_buffer; }
+    const util::buffer_view & buffer() const { return m_buffer; }
+
+    template <typename T>
+    void write(T val);
+    template <typename T, typename WRITER>
+    void write(T && val, WRITER && wrt);
+
+private:
+    friend class excerpt_appender;
+    excerpt_reservation(region_ptr data_region, std::int32_t cycle, std::int32_t thread_id, std::int32_t offset, std::int32_t capacity);
+
+    region_ptr m_data_region;
+    std::int32_t m_cycle;
+    std::int32_t m_thread_id;
+    std::int32_t m_offset;
+    std::int32_t m_capacity;
+    std::int64_t m_index;
+    util::buffer_view m_buffer;
+};
+
 class excerpt_appender
 {
 public:
+    /// What start_excerpt() does when the writers are too far ahead of the slowest consumer (see max_lead())
+    enum class lead_policy
+    {
+        spin,       ///< busy-spin until the consumer catches up
+        block,      ///< sleep until the consumer catches up
+        drop,       ///< give up - start_excerpt() returns false
+        callback    ///< ask the callback: write anyway (true) or drop (false)
+    };
+
+    /// Called with the current lead (in excerpts) when lead_policy::callback applies
+    using lead_callback_t = std::function<bool(std::int64_t)>;
+
+    /**
+     * Create an appender writing as the native id of the calling thread.
+     * An appender continues in the last data file of its thread id in the cycle unless another appender
+     * of this process is writing into it (see vanilla_data::data_for_append()). The native thread ids
+     * of a restarted process are different - so only the appenders with a fixed writer id resume
+     * the files of a previous run.
+     * Throw std::logic_error if the chronicle has a shared header (vanilla_header) but the settings do not
+     * turn it on - the readers watching the header would miss the excerpts of this appender.
+     */
     excerpt_appender(vanilla_chronicle & chronicle);
+    /**
+     * Create an appender that always writes as writer_id instead of the native id of the calling thread.
+     * Such an appender can be moved between threads without resetting its regions.
+     * The fixed ids live above the native ones - in [vanilla_chronicle::first_writer_id(), thread_id_mask()] -
+     * and are claimed exclusively by a lock file in the chronicle directory until the appender is destroyed,
+     * whichever process or pool asks for them. Throw std::invalid_argument for an id out of the range
+     * and std::runtime_error if the id is in use.
+     */
+    excerpt_appender(vanilla_chronicle & chronicle, std::int32_t writer_id);
+
+    excerpt_appender(excerpt_appender && other) noexcept;
+    excerpt_appender(const excerpt_appender &) = delete;
+    excerpt_appender & operator=(const excerpt_appender &) = delete;
+
+    /// The fixed writer id of this appender or -1 if the native thread id is used
+    std::int32_t writer_id() const { return m_writer_id; }
 
     std::int64_t index() const { return m_index; }
     std::int64_t last_written_index() const { return m_last_written_index; }
 
-    void start_excerpt(std::int32_t capacity);
+    /// Start an excerpt of up to capacity bytes. Return false if it has been dropped (see max_lead()).
+    bool start_excerpt(std::int32_t capacity);
+
+    /**
+     * Bound how many excerpts the writers may get ahead of the slowest consumer registered in the chronicle
+     * checkpoint store (see excerpt_tailer::checkpoint()) - 0 removes the bound. Without any checkpoints
+     * there is no bound either.
+     * The checkpoints are only read when the last known position of the slowest consumer says the bound
+     * might have been reached, so the check is a subtraction otherwise.
+     */
+    excerpt_appender & max_lead(std::int64_t excerpts, lead_policy policy = lead_policy::block, lead_callback_t callback = lead_callback_t());
+    std::int64_t max_lead() const { return m_max_lead; }
+    /// Number of excerpts dropped because of max_lead()
+    std::uint64_t dropped() const { return m_dropped; }
 
     void finish();
 
+    /**
+     * Reserve space for an excerpt of up to capacity bytes in the data region.
+     * Reservations are carved one after another from the data region, can be filled in parallel and
+     * committed in any order. Only the reservation/commit calls themselves must not be concurrent.
+     * Must not be called while an excerpt started with start_excerpt() is in progress.
+     */
+    excerpt_reservation reserve(std::int32_t capacity);
+
+    /// Publish a reserved excerpt (append its index entry). Return the index of the excerpt.
+    std::int64_t commit(excerpt_reservation & reservation);
+
     util::buffer_view & buffer() { return m_buffer; }
     const util::buffer_view & buffer() const { return m_buffer; }
 
@@ -53,28 +156,64 @@ public:
 
 private:
     void start_excerpt(std::int32_t capacity, std::int32_t cycle);
+    void prepare(std::int32_t capacity, std::int32_t cycle);
+    void publish(std::int32_t cycle, std::int32_t thread_id, const region & data_region, const std::uint8_t * data);
     std::int64_t index_from(std::int64_t cycle, std::int64_t index_count, std::int64_t index_position) const;
     void set_last_written_index(std::int64_t cycle, std::int64_t index_count, std::int64_t inde_position);
+    /// Record the time of the index entry in the time index (if it is one of the sampled entries)
+    void record_time(std::int32_t cycle, std::int32_t index_file_number, std::int64_t index_position);
+    /// Return false if the excerpt has to be dropped because the writers are too far ahead of the slowest consumer
+    bool check_lead();
+    /// The current lead over the slowest consumer (-1 if there are no consumers) - an upper bound unless refreshed
+    std::int64_t current_lead(bool refresh);
 
     vanilla_chronicle & m_chronicle;
+    const std::int32_t m_writer_id;
+    /// The exclusive claim of the fixed writer id (none for the native ids)
+    std::unique_ptr<util::file_lock> m_writer_lock;
 
     region_ptr m_index_region;
     region_ptr m_data_region;
+    region_ptr m_time_region;
+    std::int32_t m_time_cycle = -1;
 
     std::int64_t m_index;
     std::int32_t m_last_cycle;
     std::int32_t m_last_index_file_number;
 
     std::int32_t m_last_thread_id;
-    std::int32_t m_last_data_file_number;
+    /// The data file this appender has to itself and its position in it
+    vanilla_data::append_lease_ptr m_data_lease;
 
     bool m_finished;
 
     std::int64_t m_last_written_index = -1;
     util::buffer_view m_buffer;
 
+    std::int64_t m_max_lead = 0;
+    lead_policy m_lead_policy = lead_policy::block;
+    lead_callback_t m_lead_callback;
+    std::uint64_t m_dropped = 0;
+    // The lead was m_known_lead when the last written index was m_lead_written
+    std::int64_t m_known_lead = -1;
+    std::int64_t m_lead_written = -1;
+
 };
 
+template<typename T>
+BOOST_FORCEINLINE void excerpt_reservation::write(T val)
+{
+    static_assert(std::is_pod<T>::value, "excerpt_reservation::write(): POD expected for T");
+    std::memcpy(m_buffer.data() + m_buffer.position(), &val, sizeof(T));
+    m_buffer.position() += static_cast<std::int32_t>(sizeof(T));
+}
+
+template <typename T, typename WRITER>
+BOOST_FORCEINLINE void excerpt_reservation::write(T && val, WRITER && wrt)
+{
+    wrt(m_buffer.data(), m_buffer.position(), std::forward<T>(val));
+}
+
 template<typename T>
 BOOST_FORCEINLINE void excerpt_appender::write(T val)
 {
@@ -23,6 +23,11 @@ limitations under the License.
 #include "util/math_util.h"
 #include "util/streamer.h"
 
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <tuple>
+
 namespace cornelich
 {
 
@@ -34,7 +39,64 @@ excerpt_tailer::excerpt_tailer(vanilla_chronicle & chronicle)
     , m_last_thread_id(-1)
     , m_last_data_file_number(-1)
     , m_buffer(m_index)
+    , m_excerpt_thread_id(-1)
+    , m_excerpt_data_file_number(-1)
+    , m_excerpt_data_offset(-1)
+    , m_lazy_data(false)
+    , m_data_pending(false)
+    , m_recent_data_regions()
+    , m_recent_data_region_next(0)
+    , m_writer_filter()
+    , m_filter_from(-1)
+    , m_filter_to(-1)
+    , m_prefetch_distance(4)
+    , m_prefetched_index(-1)
+    , m_reverse(false)
+    , m_same_process_writers(false)
+    , m_probed_index(-1)
+    , m_probed_watermark(-1)
+{
+}
+
+excerpt_tailer::excerpt_tailer(excerpt_tailer && other) noexcept
+    : m_chronicle(other.m_chronicle)
+    , m_index_region(std::move(other.m_index_region))
+    , m_data_region(std::move(other.m_data_region))
+    , m_index(other.m_index)
+    , m_last_cycle(other.m_last_cycle)
+    , m_last_index_file_number(other.m_last_index_file_number)
+    , m_last_thread_id(other.m_last_thread_id)
+    , m_last_data_file_number(other.m_last_data_file_number)
+    , m_buffer(m_index)
+    , m_excerpt_thread_id(other.m_excerpt_thread_id)
+    , m_excerpt_data_file_number(other.m_excerpt_data_file_number)
+    , m_excerpt_data_offset(other.m_excerpt_data_offset)
+    , m_lazy_data(other.m_lazy_data)
+    , m_data_pending(other.m_data_pending)
+    , m_recent_data_regions(std::move(other.m_recent_data_regions))
+    , m_recent_data_region_next(other.m_recent_data_region_next)
+    , m_writer_filter(std::move(other.m_writer_filter))
+    , m_filter_from(other.m_filter_from)
+    , m_filter_to(other.m_filter_to)
+    , m_prefetch_distance(other.m_prefetch_distance)
+    , m_prefetched_index(other.m_prefetched_index)
+    , m_reverse(other.m_reverse)
+    , m_same_process_writers(other.m_same_process_writers)
+    , m_probed_index(other.m_probed_index)
+    , m_probed_watermark(other.m_probed_watermark)
+    , m_request_order(std::move(other.m_request_order))
+    , m_data_requests(std::move(other.m_data_requests))
+    , m_batch_values(std::move(other.m_batch_values))
+    , m_batch_thread_ids(std::move(other.m_batch_thread_ids))
+    , m_batch_file_numbers(std::move(other.m_batch_file_numbers))
+    , m_batch_offsets(std::move(other.m_batch_offsets))
+    , m_batch(std::move(other.m_batch))
+    , m_batch_regions(std::move(other.m_batch_regions))
 {
+    // The buffer refers to the index of its owner - rebind it
+    m_buffer.reset(other.m_buffer.data(), other.m_buffer.position(), other.m_buffer.limit());
+    other.m_buffer.reset();
+    other.m_data_pending = false;
 }
 
 excerpt_tailer & excerpt_tailer::to_start()
@@ -56,8 +118,46 @@ excerpt_tailer & excerpt_tailer::to_end()
     return *this;
 }
 
+std::int64_t excerpt_tailer::watermark() const
+{
+    return m_chronicle.m_header
+            ? m_chronicle.m_header->sequence()
+            : m_chronicle.m_last_written_index->load(std::memory_order_acquire);
+}
+
+bool excerpt_tailer::block_next_index(std::int64_t timeout)
+{
+    auto * header = m_chronicle.header();
+    if(!header)
+        throw std::logic_error("The chronicle has no shared header");
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout);
+    while(true)
+    {
+        // Read before looking - a commit after the look changes it and wait() returns at once
+        const auto word = header->futex_word();
+        if(next_index())
+            return true;
+
+        auto remaining = std::int64_t(-1);
+        if(timeout >= 0)
+        {
+            remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - std::chrono::steady_clock::now()).count();
+            if(remaining <= 0)
+                return false;
+        }
+        header->wait(word, remaining);
+    }
+}
+
 bool excerpt_tailer::next_index()
 {
+    m_reverse = false;
+    // Nothing has been written since the last unsuccessful look
+    const auto watermark = this->watermark();
+    if((m_same_process_writers || m_chronicle.m_header) && m_probed_index == m_index && m_probed_watermark == watermark && m_index >= 0)
+        return false;
+
     if(m_index < 0)
     {
         to_start();
@@ -68,6 +168,8 @@ bool excerpt_tailer::next_index()
     auto next = m_index + 1;
     while(true)
     {
+        if(!m_writer_filter.empty())
+            next = skip_filtered(next);
         auto found = index(next);
         if(found)
         {
@@ -75,30 +177,243 @@ bool excerpt_tailer::next_index()
             return true;
         }
 
+        // Jump straight to the next existing cycle
         auto cycle = static_cast<std::int32_t>(next / m_chronicle.m_settings.entries_per_cycle());
-        if(cycle > cycle_for_now(m_chronicle.m_settings.cycle_length()))
+        auto next_cycle = m_chronicle.m_directory.next_cycle(cycle);
+        if(next_cycle < 0)
+        {
+            m_probed_index = m_index;
+            m_probed_watermark = watermark;
             return false;
-        next = (cycle + 1) * m_chronicle.m_settings.entries_per_cycle();
+        }
+        next = next_cycle * m_chronicle.m_settings.entries_per_cycle();
+    }
+}
+
+bool excerpt_tailer::prev_index()
+{
+    m_reverse = true;
+    const auto previous = m_index;
+    bool found = m_index < 0 ? last_entry() : prev_entry();
+    // The writer filter - one entry at a time
+    while(found && !m_writer_filter.empty() && !writer_accepted(m_excerpt_thread_id))
+        found = prev_entry();
+    if(!found && m_index != previous)
+    {
+        // Stay where we were
+        if(previous >= 0)
+            index(previous);
+        m_index = previous;
+    }
+    return found;
+}
+
+bool excerpt_tailer::last_entry()
+{
+    auto last_index = m_chronicle.last_index();
+    return last_index >= 0 && index(last_index);
+}
+
+bool excerpt_tailer::writer_accepted(std::int32_t thread_id) const
+{
+    const auto word = static_cast<std::size_t>(thread_id) >> 6;
+    return word < m_writer_filter.size() && ((m_writer_filter[word] >> (thread_id & 63)) & 1);
+}
+
+bool excerpt_tailer::prev_entry()
+{
+
+    // Within the current index file - the entries in there are contiguous
+    if(m_index & m_chronicle.m_index_block_longs_mask)
+        return index(m_index - 1);
+
+    auto cycle = static_cast<std::int32_t>(util::right_shift(m_index, m_chronicle.m_entries_for_cycle_bits));
+    auto index_file_number = static_cast<std::int32_t>(util::right_shift(m_index & m_chronicle.m_entries_for_cycle_mask, m_chronicle.m_index_block_longs_bits));
+    while(true)
+    {
+        // The previous index file, or the last one of the previous (existing) cycle
+        if(--index_file_number < 0)
+        {
+            cycle = m_chronicle.m_directory.prev_cycle(cycle);
+            if(cycle < 0)
+                return false;
+            index_file_number = m_chronicle.m_index.last_index_file_number(cycle, -1);
+            if(index_file_number < 0)
+                continue;
+        }
+
+        auto region = m_chronicle.m_index.index_for(cycle, index_file_number, false);
+        const auto last_entry = region ? vanilla_index::find_last_entry(*region) : -1;
+        if(last_entry < 0)
+            continue;
+        return index((static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits)
+                     + (static_cast<std::int64_t>(index_file_number) << m_chronicle.m_index_block_longs_bits)
+                     + last_entry);
     }
 }
 
+void excerpt_tailer::checkpoint(const std::string & name)
+{
+    m_chronicle.checkpoints().store(name, m_index);
+}
+
+bool excerpt_tailer::resume(const std::string & name)
+{
+    const auto index = m_chronicle.checkpoints().load(name);
+    if(index < 0)
+        return false;
+    const auto current = m_index;
+    if(this->index(index))
+        return true;
+    if(current >= 0)
+        this->index(current);
+    return false;
+}
+
+bool excerpt_tailer::seek_time(std::int64_t time)
+{
+    // The cycle of the time or the next existing one
+    const auto cycle = m_chronicle.m_directory.next_cycle(static_cast<std::int32_t>(time / 1000 / m_chronicle.m_settings.cycle_length()) - 1);
+    if(cycle < 0)
+        return false;
+
+    const auto cycle_start = static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits;
+    auto before = cycle_start - 1;
+
+    auto & time_index = m_chronicle.m_time_index;
+    if(time_index.enabled())
+    {
+        // The last index file with its first entry recorded before the time...
+        std::int32_t lo = 0;
+        std::int32_t hi = m_chronicle.m_index.last_index_file_number(cycle, -1);
+        region_ptr found;
+        while(lo <= hi)
+        {
+            const auto mid = lo + (hi - lo) / 2;
+            auto region = time_index.time_for(cycle, mid, false);
+            const auto first = region ? region->read_ordered64(0) : 0;
+            if(first && first < time)
+            {
+                found = std::move(region);
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid - 1;
+            }
+        }
+        // ...and the last entry recorded before the time in there. The time gets recorded after
+        // the entry is appended - so that entry and all before it got written before the time.
+        if(found)
+        {
+            const auto slot = vanilla_time_index::find_last_before(*found, time);
+            before = cycle_start
+                    + (static_cast<std::int64_t>(found->index()) << m_chronicle.m_index_block_longs_bits)
+                    + (slot << time_index.interval_bits());
+        }
+    }
+
+    const auto previous = m_index;
+    m_index = before;
+    if(next_index())
+        return true;
+    m_index = previous;
+    return false;
+}
+
+namespace
+{
+
+/// Return the last value in [lo, hi] for which the (monotonic) predicate holds or lo - 1 if there is none
+template <typename T, typename PREDICATE>
+T find_last(T lo, T hi, PREDICATE && predicate)
+{
+    auto found = lo - 1;
+    while(lo <= hi)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        if(predicate(mid))
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+}
+
+bool excerpt_tailer::seek_lower_bound(const std::function<bool(excerpt_tailer &)> & before)
+{
+    const auto previous = m_index;
+    const auto cycles = m_chronicle.m_directory.cycles();
+    const auto cycle_count = static_cast<std::int32_t>(cycles.size());
+
+    // The first entry of a cycle (or of the next non-empty one); cycles with no entries get skipped
+    auto first_non_empty = [&](std::int32_t i)
+    {
+        for(; i < cycle_count; ++i)
+        {
+            if(index(static_cast<std::int64_t>(cycles[static_cast<std::size_t>(i)]) << m_chronicle.m_entries_for_cycle_bits))
+                return i;
+        }
+        return cycle_count;
+    };
+
+    // The last cycle starting before the key...
+    const auto last_cycle = find_last(0, cycle_count - 1, [&](std::int32_t i)
+    {
+        return first_non_empty(i) < cycle_count && before(*this);
+    });
+
+    std::int64_t found = -1;
+    if(last_cycle >= 0)
+    {
+        const auto cycle = cycles[static_cast<std::size_t>(first_non_empty(last_cycle))];
+        const auto cycle_start = static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits;
+
+        // ...the last index file starting before the key (files can end before they are full - e.g. the last one)...
+        const auto last_file = find_last(0, m_chronicle.m_index.last_index_file_number(cycle, 0), [&](std::int32_t f)
+        {
+            return index(cycle_start + (static_cast<std::int64_t>(f) << m_chronicle.m_index_block_longs_bits)) && before(*this);
+        });
+        const auto file_start = cycle_start + (static_cast<std::int64_t>(last_file) << m_chronicle.m_index_block_longs_bits);
+
+        // ...and the last entry before the key in there
+        index(file_start);
+        const auto & index_region = *m_index_region;
+        const auto entries = find_last(INT64_C(0), (index_region.size() >> 3) - 1, [&index_region](std::int64_t e)
+        {
+            return index_region.read_ordered64(static_cast<std::int32_t>(e << 3)) != 0;
+        }) + 1;
+        found = file_start + find_last(INT64_C(0), entries - 1, [&](std::int64_t e)
+        {
+            return index(file_start + e) && before(*this);
+        });
+    }
+
+    // The excerpt following the last one before the key
+    m_index = found;
+    if(next_index())
+        return true;
+    if(previous >= 0)
+        index(previous);
+    m_index = previous;
+    return false;
+}
+
 bool excerpt_tailer::index(std::int64_t index)
 {
     auto cycle_for_index = static_cast<int32_t>(util::right_shift(index, m_chronicle.m_entries_for_cycle_bits));
     auto index_file_number = static_cast<int32_t>(util::right_shift(index & m_chronicle.m_entries_for_cycle_mask, m_chronicle.m_index_block_longs_bits));
     auto index_offset = index & m_chronicle.m_index_block_longs_mask;
 
-    bool index_file_change = false;
-
-    if(m_last_cycle != cycle_for_index || m_last_index_file_number != index_file_number || !m_index_region)
-    {
-        m_index_region = m_chronicle.m_index.index_for(cycle_for_index, index_file_number, false);
-        if(!m_index_region)
-            return false;
-        index_file_change = true;
-        m_last_cycle = cycle_for_index;
-        m_last_index_file_number = index_file_number;
-    }
+    if(!load_index_region(cycle_for_index, index_file_number))
+        return false;
 
     auto index_value = m_index_region->read_ordered64(static_cast<std::int32_t>(index_offset << 3));
     if(!index_value)
@@ -109,12 +424,36 @@ bool excerpt_tailer::index(std::int64_t index)
     auto data_file_number = static_cast<std::int32_t>(util::right_shift(data_offset0, m_chronicle.m_data_block_size_bits));
     auto data_offset = static_cast<std::int32_t>(data_offset0 & m_chronicle.m_data_block_size_mask);
 
-    if(m_last_thread_id != thread_id || m_last_data_file_number != data_file_number || index_file_change)
-        m_data_region.reset();
+    if(m_lazy_data)
+    {
+        // The data is always written before the index entry gets published
+        m_excerpt_thread_id = thread_id;
+        m_excerpt_data_file_number = data_file_number;
+        m_excerpt_data_offset = data_offset;
+        m_data_pending = true;
+        m_index = index;
+        return true;
+    }
 
-    if (!m_data_region)
+    if(!load_data(thread_id, data_file_number, data_offset))
+        return false;
+    m_excerpt_thread_id = thread_id;
+    m_excerpt_data_file_number = data_file_number;
+    m_excerpt_data_offset = data_offset;
+    m_data_pending = false;
+    m_index = index;
+
+    if(m_prefetch_distance > 0)
+        prefetch(index);
+
+    return true;
+}
+
+bool excerpt_tailer::load_data(std::int32_t thread_id, std::int32_t data_file_number, std::int32_t data_offset)
+{
+    if(m_last_thread_id != thread_id || m_last_data_file_number != data_file_number || !m_data_region)
     {
-        m_data_region = m_chronicle.m_data.data_for(cycle_for_index, thread_id, data_file_number, false);
+        m_data_region = data_region_for(thread_id, data_file_number);
         m_last_thread_id = thread_id;
         m_last_data_file_number = data_file_number;
     }
@@ -131,14 +470,388 @@ bool excerpt_tailer::index(std::int64_t index)
         throw std::logic_error(util::streamer() << "Corrupted length 0x" << std::hex << len);
 
     m_buffer.reset(m_data_region->data() + data_offset, 0, len2);
-    __builtin_prefetch(m_data_region->data() + 64, 0);
-    m_index = index;
+    return true;
+}
 
+void excerpt_tailer::load_pending_data()
+{
+    m_data_pending = false;
+    if(!load_data(m_excerpt_thread_id, m_excerpt_data_file_number, m_excerpt_data_offset))
+        throw std::runtime_error(util::streamer() << "No data for the excerpt at index " << m_index);
+    if(m_prefetch_distance > 0)
+        prefetch(m_index);
+}
+
+bool excerpt_tailer::load_index_region(std::int32_t cycle, std::int32_t index_file_number)
+{
+    if(m_last_cycle != cycle || m_last_index_file_number != index_file_number || !m_index_region)
+    {
+        m_index_region = m_chronicle.m_index.index_for(cycle, index_file_number, false);
+        if(!m_index_region)
+            return false;
+        if(m_last_cycle != cycle)
+        {
+            // Data regions belong to a cycle
+            m_data_region.reset();
+            m_recent_data_regions.fill(recent_data_region());
+        }
+        m_last_cycle = cycle;
+        m_last_index_file_number = index_file_number;
+    }
     return true;
 }
 
+excerpt_tailer & excerpt_tailer::writer_filter(const std::vector<std::int32_t> & writer_ids)
+{
+    m_writer_filter.clear();
+    for(auto writer_id : writer_ids)
+    {
+        if((writer_id & m_chronicle.m_settings.thread_id_mask()) != writer_id)
+            throw std::invalid_argument(util::streamer() << "Writer id " << writer_id << " does not fit in "
+                                        << m_chronicle.m_settings.thread_id_bits() << " bits");
+        const auto word = static_cast<std::size_t>(writer_id >> 6);
+        if(m_writer_filter.size() <= word)
+            m_writer_filter.resize(word + 1, 0);
+        m_writer_filter[word] |= UINT64_C(1) << (writer_id & 63);
+    }
+    m_filter_from = m_filter_to = -1;
+    return *this;
+}
+
+std::int64_t excerpt_tailer::skip_filtered(std::int64_t next)
+{
+    // Entries skipped by the previous call are published and do not match - no need to look at them again
+    if(next == m_filter_from)
+        next = m_filter_to;
+    const auto from = next;
+
+    const auto offset_bits = m_chronicle.m_settings.index_data_offset_bits();
+    const auto * filter = m_writer_filter.data();
+    const auto filter_words = m_writer_filter.size();
+
+    while(true)
+    {
+        auto cycle = static_cast<int32_t>(util::right_shift(next, m_chronicle.m_entries_for_cycle_bits));
+        auto index_file_number = static_cast<int32_t>(util::right_shift(next & m_chronicle.m_entries_for_cycle_mask, m_chronicle.m_index_block_longs_bits));
+        if(!load_index_region(cycle, index_file_number))
+            break;
+
+        auto offset = next & m_chronicle.m_index_block_longs_mask;
+        const auto entries = static_cast<std::int64_t>(m_index_region->size() >> 3);
+        const auto & index = *m_index_region;
+        std::uint32_t stop = 0;
+        // A cache line (8 entries) at a time: an entry stops the scan when it is not published yet or it matches the filter
+        for(; offset < entries; offset = (offset & ~INT64_C(7)) + 8)
+        {
+            // The writers are publishing entries meanwhile - load them as the rest of the index reads do
+            const auto line = static_cast<std::int32_t>((offset & ~INT64_C(7)) << 3);
+            std::int64_t values[8];
+            for(std::int32_t i = 0; i != 8; ++i)
+                values[i] = index.read_ordered64(line + (i << 3));
+            stop = 0;
+            for(std::uint32_t i = 0; i != 8; ++i)
+            {
+                const auto thread_id = static_cast<std::size_t>(util::right_shift(values[i], offset_bits));
+                const auto word = thread_id >> 6;
+                const auto bits = word < filter_words ? filter[word] : 0;
+                const auto match = (values[i] == 0) | ((bits >> (thread_id & 63)) & 1);
+                stop |= static_cast<std::uint32_t>(match) << i;
+            }
+            // Ignore the entries before the starting one
+            stop &= ~0u << (offset & 7);
+            if(stop)
+                break;
+        }
+        if(stop)
+        {
+            next = (next & ~m_chronicle.m_index_block_longs_mask) + (offset & ~INT64_C(7)) + __builtin_ctz(stop);
+            break;
+        }
+        // Nothing in this index file - continue with the next one
+        next = (next & ~m_chronicle.m_index_block_longs_mask) + entries;
+    }
+
+    m_filter_from = from;
+    m_filter_to = next;
+    return next;
+}
+
+region_ptr excerpt_tailer::data_region_for(std::int32_t thread_id, std::int32_t data_file_number)
+{
+    for(auto & recent : m_recent_data_regions)
+    {
+        if(recent.region && recent.thread_id == thread_id && recent.data_file_number == data_file_number)
+            return recent.region;
+    }
+
+    auto region = m_chronicle.m_data.data_for(m_last_cycle, thread_id, data_file_number, false);
+    if(region)
+        m_recent_data_regions[m_recent_data_region_next++ % RECENT_DATA_REGIONS] = {thread_id, data_file_number, region};
+    return region;
+}
+
+region * excerpt_tailer::find_recent_data_region(std::int32_t thread_id, std::int32_t data_file_number) const
+{
+    for(auto & recent : m_recent_data_regions)
+    {
+        if(recent.region && recent.thread_id == thread_id && recent.data_file_number == data_file_number)
+            return recent.region.get();
+    }
+    return nullptr;
+}
+
+void excerpt_tailer::prefetch(std::int64_t index)
+{
+    // Entries up to m_prefetched_index were handled by the previous calls when moving in the same direction,
+    // so in the steady state only the entry 'distance' ahead (or behind) is new
+    const auto step = m_reverse ? -1 : 1;
+    const auto last = index + step * m_prefetch_distance;
+    const auto handled = m_reverse
+            ? (m_prefetched_index < index && m_prefetched_index > last)
+            : (m_prefetched_index > index && m_prefetched_index < last);
+    auto next = handled ? m_prefetched_index + step : index + step;
+
+    // Never leave the current index file
+    const auto file_start = index & ~m_chronicle.m_index_block_longs_mask;
+    const auto file_end = file_start + m_chronicle.m_index_block_longs_mask;
+
+    // The index entries themselves
+    if(last >= file_start && last <= file_end)
+        __builtin_prefetch(m_index_region->data() + ((last & m_chronicle.m_index_block_longs_mask) << 3), 0);
+
+    for(; next != last + step && next >= file_start && next <= file_end; next += step)
+    {
+        const auto index_value = m_index_region->read_ordered64(static_cast<std::int32_t>((next & m_chronicle.m_index_block_longs_mask) << 3));
+        if(!index_value)
+            break;
+        prefetch_entry(index_value);
+        m_prefetched_index = next;
+    }
+}
+
+void excerpt_tailer::prefetch_entry(std::int64_t index_value)
+{
+    const auto thread_id = static_cast<std::int32_t>(util::right_shift(index_value, m_chronicle.m_settings.index_data_offset_bits()));
+    const auto data_offset0 = index_value & m_chronicle.m_settings.index_data_offset_mask();
+    const auto data_file_number = static_cast<std::int32_t>(util::right_shift(data_offset0, m_chronicle.m_data_block_size_bits));
+    const auto data_offset = data_offset0 & m_chronicle.m_data_block_size_mask;
+
+    // Only the regions that are already mapped - mapping a new one is not worth it for a prefetch
+    const auto * data_region = (thread_id == m_last_thread_id && data_file_number == m_last_data_file_number)
+            ? m_data_region.get()
+            : find_recent_data_region(thread_id, data_file_number);
+    if(data_region)
+    {
+        // The length word and the first cache lines of the excerpt
+        const auto * p = data_region->data() + data_offset - 4;
+        __builtin_prefetch(p, 0);
+        __builtin_prefetch(p + 64, 0);
+    }
+}
+
+util::array_view<const excerpt_view> excerpt_tailer::next_batch(std::size_t max_n)
+{
+    m_batch.clear();
+    m_batch_regions.clear();
+
+    // The first excerpt goes through the regular path (start of the chronicle, index file and cycle changes)
+    if(!max_n || !next_index())
+        return {};
+    ensure_data();
+
+    if(!m_writer_filter.empty())
+    {
+        // The matching excerpts are not contiguous - collect them one by one
+        m_batch.push_back({m_index, m_buffer.data(), m_buffer.limit()});
+        m_batch_regions.push_back(m_data_region);
+        while(m_batch.size() != max_n && next_index())
+        {
+            ensure_data();
+            m_batch.push_back({m_index, m_buffer.data(), m_buffer.limit()});
+            if(m_batch_regions.back() != m_data_region)
+                m_batch_regions.push_back(m_data_region);
+        }
+        return {m_batch.data(), m_batch.size()};
+    }
+
+    m_batch.push_back({m_index, m_buffer.data(), m_buffer.limit()});
+    m_batch_regions.push_back(m_data_region);
+
+    // Collect the rest of the entries published in the current index region
+    const auto first_offset = (m_index & m_chronicle.m_index_block_longs_mask) + 1;
+    const auto entries = std::min(static_cast<std::int64_t>(max_n - 1), (m_index_region->size() >> 3) - first_offset);
+    m_batch_values.resize(static_cast<std::size_t>(std::max<std::int64_t>(entries, 0)));
+    std::size_t count = 0;
+    for(; count != m_batch_values.size(); ++count)
+    {
+        const auto value = m_index_region->read_ordered64(static_cast<std::int32_t>((first_offset + static_cast<std::int64_t>(count)) << 3));
+        if(!value)
+            break;
+        m_batch_values[count] = value;
+    }
+
+    // Decode the entries into (thread id, data file number, data offset) - kept branch-free so it vectorizes
+    m_batch_thread_ids.resize(count);
+    m_batch_file_numbers.resize(count);
+    m_batch_offsets.resize(count);
+    {
+        const auto thread_id_shift = m_chronicle.m_settings.index_data_offset_bits();
+        const auto offset_mask = m_chronicle.m_settings.index_data_offset_mask();
+        const auto file_shift = m_chronicle.m_data_block_size_bits;
+        const auto block_mask = m_chronicle.m_data_block_size_mask;
+        const auto * values = m_batch_values.data();
+        auto * thread_ids = m_batch_thread_ids.data();
+        auto * file_numbers = m_batch_file_numbers.data();
+        auto * offsets = m_batch_offsets.data();
+        for(std::size_t i = 0; i < count; ++i)
+        {
+            const auto value = values[i];
+            thread_ids[i] = static_cast<std::int32_t>(util::right_shift(value, thread_id_shift));
+            file_numbers[i] = static_cast<std::int32_t>(util::right_shift(value & offset_mask, file_shift));
+            offsets[i] = static_cast<std::int32_t>(value & block_mask);
+        }
+    }
+
+    // Resolve the data regions - only when the writer or the data file changes
+    auto * data_region = m_data_region.get();
+    auto thread_id = m_last_thread_id;
+    auto data_file_number = m_last_data_file_number;
+    for(std::size_t i = 0; i != count; ++i)
+    {
+        if(m_batch_thread_ids[i] != thread_id || m_batch_file_numbers[i] != data_file_number)
+        {
+            auto region = data_region_for(m_batch_thread_ids[i], m_batch_file_numbers[i]);
+            if(!region)
+                break;
+            data_region = region.get();
+            thread_id = m_batch_thread_ids[i];
+            data_file_number = m_batch_file_numbers[i];
+            m_batch_regions.push_back(std::move(region));
+        }
+
+        const auto data_offset = m_batch_offsets[i];
+        const auto len = data_region->read_ordered32(data_offset - 4);
+        if(!len)
+            break;
+        const auto len2 = ~len;
+        if(util::right_shift(len2, 30))
+            throw std::logic_error(util::streamer() << "Corrupted length 0x" << std::hex << len);
+
+        m_batch.push_back({m_index + 1, data_region->data() + data_offset, len2});
+        m_index += 1;
+        m_excerpt_thread_id = thread_id;
+        m_excerpt_data_file_number = data_file_number;
+        m_excerpt_data_offset = data_offset;
+        if(data_region != m_data_region.get())
+        {
+            m_data_region = m_batch_regions.back();
+            m_last_thread_id = thread_id;
+            m_last_data_file_number = data_file_number;
+        }
+    }
+
+    const auto & last = m_batch.back();
+    m_buffer.reset(const_cast<std::uint8_t *>(last.data), 0, last.length);
+
+    return {m_batch.data(), m_batch.size()};
+}
+
+util::array_view<const excerpt_view> excerpt_tailer::multi_get(util::array_view<const std::int64_t> indices)
+{
+    m_batch.assign(indices.size(), excerpt_view{-1, nullptr, 0});
+    m_batch_regions.clear();
+    m_data_requests.clear();
+
+    // Resolve the index values - in index order so that each index region is looked up once
+    m_request_order.resize(indices.size());
+    for(std::size_t i = 0; i != indices.size(); ++i)
+        m_request_order[i] = i;
+    std::sort(m_request_order.begin(), m_request_order.end(), [&indices](std::size_t a, std::size_t b)
+    {
+        return indices[a] < indices[b];
+    });
+
+    const auto thread_id_shift = m_chronicle.m_settings.index_data_offset_bits();
+    const auto offset_mask = m_chronicle.m_settings.index_data_offset_mask();
+    region_ptr index_region;
+    std::int64_t index_region_start = -1;
+    for(auto position : m_request_order)
+    {
+        const auto index = indices[position];
+        m_batch[position].index = index;
+        if(index < 0)
+            continue;
+
+        const auto file_start = index & ~m_chronicle.m_index_block_longs_mask;
+        if(file_start != index_region_start)
+        {
+            index_region_start = file_start;
+            const auto cycle = static_cast<std::int32_t>(util::right_shift(index, m_chronicle.m_entries_for_cycle_bits));
+            const auto index_file_number = static_cast<std::int32_t>(util::right_shift(index & m_chronicle.m_entries_for_cycle_mask, m_chronicle.m_index_block_longs_bits));
+            index_region = m_chronicle.m_index.index_for(cycle, index_file_number, false);
+        }
+        if(!index_region)
+            continue;
+
+        const auto value = index_region->read_ordered64(static_cast<std::int32_t>((index & m_chronicle.m_index_block_longs_mask) << 3));
+        if(!value)
+            continue;
+        m_data_requests.push_back({position,
+                                   static_cast<std::int32_t>(util::right_shift(index, m_chronicle.m_entries_for_cycle_bits)),
+                                   static_cast<std::int32_t>(util::right_shift(value, thread_id_shift)),
+                                   static_cast<std::int32_t>(util::right_shift(value & offset_mask, m_chronicle.m_data_block_size_bits)),
+                                   static_cast<std::int32_t>(value & m_chronicle.m_data_block_size_mask),
+                                   nullptr});
+    }
+
+    // Group by data file (and go through each one in order)
+    std::sort(m_data_requests.begin(), m_data_requests.end(), [](const data_request & a, const data_request & b)
+    {
+        return std::tie(a.cycle, a.thread_id, a.data_file_number, a.data_offset) < std::tie(b.cycle, b.thread_id, b.data_file_number, b.data_offset);
+    });
+
+    // Map each data region once and prefetch the length words...
+    const data_request * group = nullptr;
+    for(auto & request : m_data_requests)
+    {
+        if(group && group->cycle == request.cycle && group->thread_id == request.thread_id && group->data_file_number == request.data_file_number)
+        {
+            request.data_region = group->data_region;
+        }
+        else
+        {
+            auto region = m_chronicle.m_data.data_for(request.cycle, request.thread_id, request.data_file_number, false);
+            request.data_region = region.get();
+            if(region)
+                m_batch_regions.push_back(std::move(region));
+            group = &request;
+        }
+        if(request.data_region)
+            __builtin_prefetch(request.data_region->data() + request.data_offset - 4, 0);
+    }
+
+    // ...then read them
+    for(auto & request : m_data_requests)
+    {
+        if(!request.data_region)
+            continue;
+        const auto len = request.data_region->read_ordered32(request.data_offset - 4);
+        if(!len)
+            continue;
+        const auto len2 = ~len;
+        if(util::right_shift(len2, 30))
+            throw std::logic_error(util::streamer() << "Corrupted length 0x" << std::hex << len);
+        auto & view = m_batch[request.position];
+        view.data = request.data_region->data() + request.data_offset;
+        view.length = len2;
+    }
+
+    return {m_batch.data(), m_batch.size()};
+}
+
 bool excerpt_tailer::position(std::int32_t position)
 {
+    ensure_data();
     if(position > m_buffer.limit())
         return false;
     m_buffer.position() = position;
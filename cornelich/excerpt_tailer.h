@@ -18,11 +18,18 @@ limitations under the License.
 #pragma once
 
 #include "region.h"
+#include "util/array_view.h"
 #include "util/buffer_view.h"
+#include "util/idle.h"
 
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 namespace cornelich
 {
@@ -30,11 +37,23 @@ namespace cornelich
 class vanilla_chronicle;
 using region_ptr = std::shared_ptr<region>;
 
+/// A read-only view of a single excerpt
+struct excerpt_view
+{
+    std::int64_t index;
+    const std::uint8_t * data;
+    std::int32_t length;
+};
+
 class excerpt_tailer
 {
 public:
     excerpt_tailer(vanilla_chronicle & chronicle);
 
+    excerpt_tailer(excerpt_tailer && other) noexcept;
+    excerpt_tailer(const excerpt_tailer &) = delete;
+    excerpt_tailer & operator=(const excerpt_tailer &) = delete;
+
     std::int64_t index() const { return m_index; }
     bool index(std::int64_t index);
 
@@ -42,19 +61,170 @@ public:
     excerpt_tailer & to_end();
 
     bool next_index();
+    /**
+     * Wait for the next excerpt: check for it with next_index(), calling idle() between the checks, until it
+     * comes or timeout microseconds have passed (a negative timeout waits forever). See util/idle.h.
+     */
+    template <typename IDLE = util::backoff_idle>
+    bool wait_next_index(std::int64_t timeout = -1, IDLE idle = IDLE());
+    /**
+     * Block on the shared header (see vanilla_header) until the next excerpt comes or timeout microseconds
+     * have passed (a negative timeout waits forever). Throws std::logic_error if the chronicle has no shared header.
+     */
+    bool block_next_index(std::int64_t timeout = -1);
+    /**
+     * Move to the previous excerpt - across the index files and cycles.
+     * When not positioned on any excerpt yet, move to the last one.
+     */
+    bool prev_index();
+
+    /**
+     * Move over up to max_n excerpts at once and return views of them.
+     * The batch covers the excerpts published so far in the index file of the next excerpt
+     * (a following call continues with the next index file / cycle).
+     * The tailer is left positioned on the last excerpt of the batch.
+     * The views stay valid until the next call to next_batch() or multi_get().
+     */
+    util::array_view<const excerpt_view> next_batch(std::size_t max_n);
+
+    /**
+     * Fetch the excerpts with the given indices and return views of them in the same order.
+     * The requests get sorted by (cycle, index file) and then by (writer, data file, offset) so that
+     * each region is mapped once per call. The view of an index with no excerpt has data == nullptr.
+     * The position of the tailer does not change. The views stay valid until the next call to next_batch() or multi_get().
+     */
+    util::array_view<const excerpt_view> multi_get(util::array_view<const std::int64_t> indices);
+
+    /// The data regions the views of the last next_batch() or multi_get() point into - holding on to them keeps the views valid
+    util::array_view<const region_ptr> batch_regions() const { return {m_batch_regions.data(), m_batch_regions.size()}; }
+    /// The data region of the current excerpt - holding on to it keeps the data of buffer() valid
+    const region_ptr & data_region() const { ensure_data(); return m_data_region; }
+
+    /**
+     * Move to the first excerpt that might have been written at or after the given time (microseconds since the epoch).
+     * That is the excerpt following the last one recorded in the time index (see vanilla_chronicle_settings::time_index_interval)
+     * before that time - or the first excerpt of the cycle of that time without a time index.
+     * Return false if there is no such excerpt (yet).
+     */
+    bool seek_time(std::int64_t time);
+    /**
+     * Move to the first excerpt written at or after the given time according to the timestamp_of(tailer) extractor,
+     * which returns the time of the current excerpt. The time index narrows down the excerpts that get scanned.
+     * Return false if there is no such excerpt (yet).
+     */
+    template <typename EXTRACTOR>
+    bool seek_time(std::int64_t time, EXTRACTOR && timestamp_of);
+
+    /**
+     * Move to the first excerpt with a key not less than the given one - where key_of(tailer) returns the key
+     * of the current excerpt and the keys increase monotonically through the chronicle (e.g. a sequence number).
+     * This is a binary search over the cycles, the index files and the entries in them.
+     * Return false if there is no such excerpt.
+     */
+    template <typename EXTRACTOR, typename KEY>
+    bool seek_by_key(EXTRACTOR && key_of, const KEY & key);
+
+    /// Store the current index as the named checkpoint in the chronicle checkpoint store
+    void checkpoint(const std::string & name);
+    /**
+     * Move to the excerpt stored as the named checkpoint - next_index() then continues after it.
+     * Return false (without moving) if there is no such checkpoint or the excerpt no longer exists.
+     */
+    bool resume(const std::string & name);
 
-    util::buffer_view & buffer() { return m_buffer; }
-    const util::buffer_view & buffer() const { return m_buffer; }
+    util::buffer_view & buffer() { ensure_data(); return m_buffer; }
+    const util::buffer_view & buffer() const { ensure_data(); return m_buffer; }
 
-    std::int32_t position() const { return m_buffer.position(); }
+    /**
+     * In the lazy data mode moving to an excerpt only reads its index entry - the data region gets mapped
+     * (and the length checked) when the data is first accessed via buffer(), read(), position() or limit().
+     * Counting, skipping or filtering excerpts by writer then never touches the data files.
+     */
+    bool lazy_data() const { return m_lazy_data; }
+    excerpt_tailer & lazy_data(bool lazy) { ensure_data(); m_lazy_data = lazy; return *this; }
+
+    /**
+     * Only stop at the excerpts written by the given writers (thread ids); an empty set removes the filter.
+     * Other entries are skipped on their index values alone, so the data files of the other writers never get mapped.
+     */
+    excerpt_tailer & writer_filter(const std::vector<std::int32_t> & writer_ids);
+
+    /// The thread (or writer) id that wrote the current excerpt
+    std::int32_t writer_id() const { return m_excerpt_thread_id; }
+    /// The data file number of the current excerpt
+    std::int32_t data_file_number() const { return m_excerpt_data_file_number; }
+    /// The offset of the current excerpt in its data file
+    std::int32_t data_offset() const { return m_excerpt_data_offset; }
+
+    /**
+     * Declare that all the writers of the chronicle are in this process. After finding nothing new, next_index()
+     * then checks the chronicle watermark (the last index written in this process, through any
+     * vanilla_chronicle of the same path - see vanilla_chronicle::last_written_index()) only and does not touch
+     * the index regions or the directory again until the watermark moves.
+     * With the shared header on (vanilla_chronicle_settings::shared_header) this is always the case - for the
+     * writers of all the processes - and the header sequence is the watermark.
+     */
+    bool same_process_writers() const { return m_same_process_writers; }
+    excerpt_tailer & same_process_writers(bool same_process) { m_same_process_writers = same_process; m_probed_index = -1; return *this; }
+
+    /// How many index entries ahead of the current one get their data prefetched (0 disables prefetching)
+    std::int32_t prefetch_distance() const { return m_prefetch_distance; }
+    excerpt_tailer & prefetch_distance(std::int32_t distance) { m_prefetch_distance = distance; return *this; }
+
+    std::int32_t position() const { ensure_data(); return m_buffer.position(); }
     bool position(std::int32_t position);
-    std::int32_t limit() const { return m_buffer.limit(); }
+    std::int32_t limit() const { ensure_data(); return m_buffer.limit(); }
 
     template <typename T>
     T read();
     template <typename READER>
     typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type read(READER && rdr);
 private:
+    /// Map the data of an excerpt into m_buffer; false when it is not available
+    bool load_data(std::int32_t thread_id, std::int32_t data_file_number, std::int32_t data_offset);
+    /// Load the data deferred by the lazy data mode
+    void ensure_data() const
+    {
+        // The data is logically a part of the current excerpt - loading it does not change the observable state
+        if(BOOST_UNLIKELY(m_data_pending))
+            const_cast<excerpt_tailer *>(this)->load_pending_data();
+    }
+    void load_pending_data();
+    /// The value that changes whenever something gets written (the header sequence or the chronicle watermark)
+    std::int64_t watermark() const;
+
+    /// Move to the first excerpt for which before(tailer) is false (before has to be monotonic over the chronicle)
+    bool seek_lower_bound(const std::function<bool(excerpt_tailer &)> & before);
+
+    /// Move to the last excerpt of the chronicle
+    bool last_entry();
+    /// Move to the previous excerpt (regardless of the writer filter)
+    bool prev_entry();
+    /// Whether the writer filter accepts the thread id
+    bool writer_accepted(std::int32_t thread_id) const;
+
+    /// Make m_index_region the given index file; false when it does not exist
+    bool load_index_region(std::int32_t cycle, std::int32_t index_file_number);
+    /// Return the first index from next on that is either not published yet or matches the writer filter
+    std::int64_t skip_filtered(std::int64_t next);
+
+    /// Return the data region for (thread_id, data_file_number) in the current cycle - from the recently used ones if possible
+    region_ptr data_region_for(std::int32_t thread_id, std::int32_t data_file_number);
+    /// Return the recently used data region for (thread_id, data_file_number) if there is one (never maps a new region)
+    region * find_recent_data_region(std::int32_t thread_id, std::int32_t data_file_number) const;
+    /// Prefetch the data of the index entries following (or preceding when moving backwards) the current one
+    void prefetch(std::int64_t index);
+    /// Prefetch the data the index value points to
+    void prefetch_entry(std::int64_t index_value);
+
+    static constexpr std::size_t RECENT_DATA_REGIONS = 4;
+    struct recent_data_region
+    {
+        std::int32_t thread_id;
+        std::int32_t data_file_number;
+        region_ptr region;
+    };
+
     vanilla_chronicle & m_chronicle;
 
     region_ptr m_index_region;
@@ -68,12 +238,81 @@ private:
     std::int32_t m_last_data_file_number;
 
     util::buffer_view m_buffer;
+
+    // The current excerpt as decoded from its index value
+    std::int32_t m_excerpt_thread_id;
+    std::int32_t m_excerpt_data_file_number;
+    std::int32_t m_excerpt_data_offset;
+
+    bool m_lazy_data;
+    bool m_data_pending;
+
+    // Data regions of the current cycle used recently (there is one per writer - so with several writers
+    // interleaving this saves going through the vanilla_data cache on every writer change)
+    std::array<recent_data_region, RECENT_DATA_REGIONS> m_recent_data_regions;
+    std::size_t m_recent_data_region_next;
+
+    // Bitset over the thread ids accepted by the writer filter (empty - no filter)
+    std::vector<std::uint64_t> m_writer_filter;
+    // The last skip_filtered() call moved from m_filter_from to m_filter_to
+    std::int64_t m_filter_from;
+    std::int64_t m_filter_to;
+
+    std::int32_t m_prefetch_distance;
+    std::int64_t m_prefetched_index;
+    // Whether the tailer is moving backwards (prev_index())
+    bool m_reverse;
+
+    bool m_same_process_writers;
+    // next_index() found nothing after m_probed_index when the watermark was m_probed_watermark
+    std::int64_t m_probed_index;
+    std::int64_t m_probed_watermark;
+
+    /// A multi_get() request resolved to its data location
+    struct data_request
+    {
+        std::size_t position;
+        std::int32_t cycle;
+        std::int32_t thread_id;
+        std::int32_t data_file_number;
+        std::int32_t data_offset;
+        const region * data_region;
+    };
+
+    // Reused by multi_get()
+    std::vector<std::size_t> m_request_order;
+    std::vector<data_request> m_data_requests;
+
+    // Reused by next_batch() and multi_get()
+    std::vector<std::int64_t> m_batch_values;
+    std::vector<std::int32_t> m_batch_thread_ids;
+    std::vector<std::int32_t> m_batch_file_numbers;
+    std::vector<std::int32_t> m_batch_offsets;
+    std::vector<excerpt_view> m_batch;
+    std::vector<region_ptr> m_batch_regions;
 };
 
+template <typename IDLE>
+bool excerpt_tailer::wait_next_index(std::int64_t timeout, IDLE idle)
+{
+    if(next_index())
+        return true;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeout);
+    while(true)
+    {
+        if(timeout >= 0 && std::chrono::steady_clock::now() >= deadline)
+            return false;
+        idle();
+        if(next_index())
+            return true;
+    }
+}
+
 template<typename T>
 BOOST_FORCEINLINE T excerpt_tailer::read()
 {
     static_assert(std::is_pod<T>::value, "excerpt_tailer::read(): POD expected for T");
+    ensure_data();
     //auto && val = *reinterpret_cast<const T *>(m_buffer.data() + m_buffer.position());
     // memcpy the data to avoid alignment issues
     T val;
@@ -82,9 +321,37 @@ BOOST_FORCEINLINE T excerpt_tailer::read()
     return val;
 }
 
+template <typename EXTRACTOR>
+bool excerpt_tailer::seek_time(std::int64_t time, EXTRACTOR && timestamp_of)
+{
+    if(!seek_time(time))
+        return false;
+    while(true)
+    {
+        const auto timestamp = timestamp_of(*this);
+        position(0);
+        if(timestamp >= time)
+            return true;
+        if(!next_index())
+            return false;
+    }
+}
+
+template <typename EXTRACTOR, typename KEY>
+bool excerpt_tailer::seek_by_key(EXTRACTOR && key_of, const KEY & key)
+{
+    return seek_lower_bound([&key_of, &key](excerpt_tailer & tailer)
+    {
+        const bool before = key_of(tailer) < key;
+        tailer.position(0);
+        return before;
+    });
+}
+
 template <typename READER>
 BOOST_FORCEINLINE typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type excerpt_tailer::read(READER && rdr)
 {
+    ensure_data();
     return rdr(m_buffer.data(), m_buffer.position());
 }
 
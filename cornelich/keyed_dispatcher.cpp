@@ -0,0 +1,201 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "keyed_dispatcher.h"
+
+#include "util/spin_lock.h"
+
+#include <stdexcept>
+
+namespace cornelich
+{
+
+namespace
+{
+
+/// Spread the keys over the workers (the keys are often small consecutive numbers)
+inline std::uint64_t mix(std::uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+}
+
+keyed_dispatcher::keyed_dispatcher(excerpt_tailer tailer,
+                                   std::size_t worker_count,
+                                   key_extractor_t key_of,
+                                   handler_t handler,
+                                   std::size_t queue_capacity,
+                                   std::size_t batch_size)
+    : m_tailer(std::move(tailer))
+    , m_key_of(std::move(key_of))
+    , m_handler(std::move(handler))
+    , m_batch_size(batch_size ? batch_size : 1)
+    , m_reading(true)
+    , m_working(true)
+    , m_dispatched(0)
+    , m_handled(0)
+    , m_last_dispatched_index(-1)
+{
+    if(!worker_count)
+        throw std::invalid_argument("At least one worker is needed");
+    for(std::size_t i = 0; i != worker_count; ++i)
+        m_queues.emplace_back(new util::spsc_queue<item>(queue_capacity));
+
+    for(std::size_t i = 0; i != worker_count; ++i)
+        m_workers.emplace_back(&keyed_dispatcher::work, this, i);
+    m_reader = std::thread(&keyed_dispatcher::read, this);
+}
+
+keyed_dispatcher::~keyed_dispatcher()
+{
+    join();
+}
+
+std::size_t keyed_dispatcher::worker_for(std::uint64_t key) const
+{
+    return static_cast<std::size_t>(mix(key) % m_queues.size());
+}
+
+void keyed_dispatcher::stop()
+{
+    join();
+    std::lock_guard<std::mutex> lk(m_error_lock);
+    if(m_error)
+        std::rethrow_exception(m_error);
+}
+
+void keyed_dispatcher::join()
+{
+    // The reader first - the workers only stop once their queues are empty and nothing more is coming
+    m_reading.store(false, std::memory_order_release);
+    if(m_reader.joinable())
+        m_reader.join();
+    m_working.store(false, std::memory_order_release);
+    for(auto && worker : m_workers)
+    {
+        if(worker.joinable())
+            worker.join();
+    }
+}
+
+void keyed_dispatcher::fail(std::exception_ptr error)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_error_lock);
+        if(!m_error)
+            m_error = error;
+    }
+    m_reading.store(false, std::memory_order_release);
+}
+
+void keyed_dispatcher::read()
+{
+    try
+    {
+        // The region each worker got last
+        std::vector<region_ptr> last_regions(m_queues.size());
+        util::default_backoff<5> backoff;
+        while(m_reading.load(std::memory_order_acquire))
+        {
+            const auto batch = m_tailer.next_batch(m_batch_size);
+            if(batch.empty())
+            {
+                backoff();
+                continue;
+            }
+            backoff = util::default_backoff<5>();
+
+            const auto regions = m_tailer.batch_regions();
+            std::size_t current = 0;
+            for(auto && view : batch)
+            {
+                // The batch regions come in the order of the views
+                while(current + 1 != regions.size() && (view.data < regions[current]->data() || view.data >= regions[current]->data() + regions[current]->size()))
+                    ++current;
+
+                const auto worker = worker_for(m_key_of(view));
+                item next{view, nullptr};
+                if(last_regions[worker] != regions[current])
+                {
+                    next.data_region = regions[current];
+                    last_regions[worker] = regions[current];
+                }
+
+                util::default_backoff<5> full_backoff;
+                while(!m_queues[worker]->try_push(std::move(next)))
+                {
+                    if(!m_reading.load(std::memory_order_acquire))
+                        return;
+                    full_backoff();
+                }
+                m_last_dispatched_index.store(view.index, std::memory_order_release);
+                m_dispatched.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+    catch(...)
+    {
+        fail(std::current_exception());
+    }
+}
+
+void keyed_dispatcher::work(std::size_t worker)
+{
+    auto & queue = *m_queues[worker];
+    // Keeps the views of the queued excerpts mapped
+    region_ptr data_region;
+    bool failed = false;
+    util::default_backoff<5> backoff;
+    while(true)
+    {
+        auto * next = queue.front();
+        if(!next)
+        {
+            if(!m_working.load(std::memory_order_acquire))
+                break;
+            backoff();
+            continue;
+        }
+        backoff = util::default_backoff<5>();
+
+        if(next->data_region)
+            data_region = std::move(next->data_region);
+        if(!failed)
+        {
+            try
+            {
+                m_handler(worker, next->view);
+            }
+            catch(...)
+            {
+                // Keep draining the queue so the reader does not get stuck
+                failed = true;
+                fail(std::current_exception());
+            }
+        }
+        queue.pop();
+        m_handled.fetch_add(1, std::memory_order_release);
+    }
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_tailer.h"
+#include "util/spsc_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cornelich
+{
+
+/**
+ * Tails a chronicle and spreads the excerpts over worker threads by key.
+ *
+ * The reading thread extracts a key from every excerpt and passes the excerpt to the worker owning the
+ * key (by hash) through a lock-free SPSC queue - so the excerpts with the same key are handled in index
+ * order, one at a time, while different keys are handled in parallel.
+ *
+ * The handler gets a view of the mapped excerpt (no copy). The view stays valid until the handler
+ * returns - which acknowledges the excerpt.
+ */
+class keyed_dispatcher
+{
+public:
+    using key_extractor_t = std::function<std::uint64_t(const excerpt_view &)>;
+    /// Called on a worker thread: (worker number, excerpt)
+    using handler_t = std::function<void(std::size_t, const excerpt_view &)>;
+
+    /**
+     * @param tailer Where to start reading (the dispatcher takes over the tailer)
+     * @param worker_count Number of worker threads
+     * @param key_of Extracts the key of an excerpt (called on the reading thread)
+     * @param handler Handles the excerpts
+     * @param queue_capacity Number of excerpts each worker queue can hold (must be a power of 2)
+     * @param batch_size Maximum number of excerpts read in one go
+     */
+    keyed_dispatcher(excerpt_tailer tailer,
+                     std::size_t worker_count,
+                     key_extractor_t key_of,
+                     handler_t handler,
+                     std::size_t queue_capacity = 1024,
+                     std::size_t batch_size = 256);
+
+    /// Stop without rethrowing the handler exception
+    ~keyed_dispatcher();
+
+    keyed_dispatcher(const keyed_dispatcher &) = delete;
+    keyed_dispatcher & operator=(const keyed_dispatcher &) = delete;
+
+    std::size_t worker_count() const { return m_queues.size(); }
+    /// The worker handling the given key
+    std::size_t worker_for(std::uint64_t key) const;
+
+    /// Number of excerpts passed to the workers so far
+    std::uint64_t dispatched() const { return m_dispatched.load(std::memory_order_acquire); }
+    /// Number of excerpts handled so far
+    std::uint64_t handled() const { return m_handled.load(std::memory_order_acquire); }
+    /// The index of the last excerpt passed to the workers (-1 if none)
+    std::int64_t last_dispatched_index() const { return m_last_dispatched_index.load(std::memory_order_acquire); }
+
+    /**
+     * Stop reading, let the workers handle what has been dispatched and join the threads.
+     * Rethrow the first exception thrown by the handler (the dispatching stops when there is one).
+     */
+    void stop();
+
+private:
+    /// An excerpt in a worker queue - carries the data region whenever it differs from the previous one
+    struct item
+    {
+        excerpt_view view;
+        region_ptr data_region;
+    };
+
+    void read();
+    void work(std::size_t worker);
+    void fail(std::exception_ptr error);
+    void join();
+
+    excerpt_tailer m_tailer;
+    const key_extractor_t m_key_of;
+    const handler_t m_handler;
+    const std::size_t m_batch_size;
+    std::vector<std::unique_ptr<util::spsc_queue<item>>> m_queues;
+
+    std::atomic<bool> m_reading;
+    std::atomic<bool> m_working;
+    std::atomic<std::uint64_t> m_dispatched;
+    std::atomic<std::uint64_t> m_handled;
+    std::atomic<std::int64_t> m_last_dispatched_index;
+
+    std::mutex m_error_lock;
+    std::exception_ptr m_error;
+
+    std::thread m_reader;
+    std::vector<std::thread> m_workers;
+};
+
+}
@@ -0,0 +1,117 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "merge_tailer.h"
+
+#include "vanilla_utils.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+merge_tailer::merge_tailer(std::vector<excerpt_tailer> sources, timestamp_extractor_t timestamp_of, std::size_t batch_size)
+    : m_timestamp_of(std::move(timestamp_of))
+    , m_batch_size(batch_size ? batch_size : 1)
+    , m_max_wait(0)
+    , m_current{-1, nullptr, 0}
+    , m_timestamp(-1)
+    , m_current_source(0)
+{
+    if(sources.empty())
+        throw std::invalid_argument("No sources to merge");
+    // The tailers get moved in once - their buffers are rebound by the excerpt_tailer move constructor
+    m_sources.reserve(sources.size());
+    m_empty.reserve(sources.size());
+    for(auto && tailer : sources)
+    {
+        m_empty.push_back(m_sources.size());
+        m_sources.push_back(input{std::move(tailer), {}, 0, -1});
+    }
+    m_heap.reserve(m_sources.size());
+}
+
+bool merge_tailer::next()
+{
+    refill();
+    if(m_heap.empty() || must_wait())
+        return false;
+
+    std::pop_heap(m_heap.begin(), m_heap.end(), std::greater<head>());
+    const auto top = m_heap.back();
+    m_heap.pop_back();
+
+    auto & s = m_sources[top.source];
+    m_current = s.batch[s.position++];
+    m_timestamp = top.timestamp;
+    m_current_source = top.source;
+
+    // The batch of the source stays until the current excerpt is done with
+    if(s.position != s.batch.size())
+        push_head(top.source);
+    else
+        m_empty.push_back(top.source);
+    return true;
+}
+
+void merge_tailer::refill()
+{
+    for(auto it = m_empty.begin(); it != m_empty.end();)
+    {
+        auto & s = m_sources[*it];
+        s.batch = s.tailer.next_batch(m_batch_size);
+        s.position = 0;
+        if(s.batch.empty())
+        {
+            ++it;
+            continue;
+        }
+        s.waiting_since = -1;
+        push_head(*it);
+        it = m_empty.erase(it);
+    }
+}
+
+bool merge_tailer::must_wait()
+{
+    if(!m_max_wait || m_empty.empty())
+        return false;
+
+    const auto now = micros_for_now();
+    auto wait = false;
+    for(auto i : m_empty)
+    {
+        auto & s = m_sources[i];
+        if(s.waiting_since < 0)
+            s.waiting_since = now;
+        // Once waited for long enough the source is left out until it catches up
+        if(now - s.waiting_since < m_max_wait)
+            wait = true;
+    }
+    return wait;
+}
+
+void merge_tailer::push_head(std::size_t source)
+{
+    auto & s = m_sources[source];
+    m_heap.push_back({m_timestamp_of(s.batch[s.position]), source});
+    std::push_heap(m_heap.begin(), m_heap.end(), std::greater<head>());
+}
+
+}
@@ -0,0 +1,115 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_tailer.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cornelich
+{
+
+/**
+ * Merges several chronicles into one stream ordered by a timestamp taken from the excerpts.
+ *
+ * Every source is read in batches (next_batch()) and the heads of the sources are kept in a min-heap,
+ * so moving on costs O(log N) for N sources. Excerpts with equal timestamps come in the order of the sources.
+ *
+ * A source that has nothing more to read is left out of the merge - unless the live mode is on: then
+ * the merge waits (next() returns false) until the source gets new excerpts, but not longer than the
+ * given time. A source that keeps lagging only holds the merge up once, until it catches up again.
+ */
+class merge_tailer
+{
+public:
+    /// Return the timestamp of an excerpt
+    using timestamp_extractor_t = std::function<std::int64_t(const excerpt_view &)>;
+
+    /**
+     * @param sources The tailers to merge (the merge tailer takes them over - they continue from where they are)
+     * @param timestamp_of Extracts the timestamp of an excerpt
+     * @param batch_size Maximum number of excerpts read from a source in one go
+     */
+    merge_tailer(std::vector<excerpt_tailer> sources, timestamp_extractor_t timestamp_of, std::size_t batch_size = 256);
+
+    /**
+     * Wait for the sources without new excerpts up to max_wait microseconds (wall-clock time) before
+     * moving on without them. 0 turns the live mode off.
+     */
+    merge_tailer & live(std::int64_t max_wait) { m_max_wait = max_wait; return *this; }
+    std::int64_t live() const { return m_max_wait; }
+
+    /// Move to the next excerpt in timestamp order. Return false if there is none at the moment.
+    bool next();
+
+    /// The current excerpt - valid until the next call to next()
+    const excerpt_view & current() const { return m_current; }
+    /// The timestamp of the current excerpt
+    std::int64_t timestamp() const { return m_timestamp; }
+    /// The number of the source of the current excerpt
+    std::size_t source() const { return m_current_source; }
+    /// The tailer of a source
+    const excerpt_tailer & tailer(std::size_t source) const { return m_sources[source].tailer; }
+
+    std::size_t source_count() const { return m_sources.size(); }
+
+private:
+    struct input
+    {
+        excerpt_tailer tailer;
+        util::array_view<const excerpt_view> batch;
+        std::size_t position;
+        /// When the merge started waiting for this source (-1 if it is not waiting)
+        std::int64_t waiting_since;
+    };
+
+    /// A source head in the heap
+    struct head
+    {
+        std::int64_t timestamp;
+        std::size_t source;
+
+        bool operator>(const head & other) const
+        {
+            return timestamp != other.timestamp ? timestamp > other.timestamp : source > other.source;
+        }
+    };
+
+    /// Read the next batch of every source that has run out of excerpts
+    void refill();
+    /// Return true if the merge has to wait for a lagging source
+    bool must_wait();
+    void push_head(std::size_t source);
+
+    std::vector<input> m_sources;
+    const timestamp_extractor_t m_timestamp_of;
+    const std::size_t m_batch_size;
+    std::int64_t m_max_wait;
+
+    std::vector<head> m_heap;
+    /// The sources to refill on the next call to next()
+    std::vector<std::size_t> m_empty;
+
+    excerpt_view m_current;
+    std::int64_t m_timestamp;
+    std::size_t m_current_source;
+};
+
+}
@@ -60,10 +60,15 @@ public:
 
     /// Perform an ordered write (4 bytes) to the given location
     void write_ordered32(std::int32_t offset, std::int32_t value);
+    /// Perform an ordered write (8 bytes) to the given location
+    void write_ordered64(std::int32_t offset, std::int64_t value);
 
     /// Perform an 8-byte CAS operation at a given offset
     bool cas64(std::int32_t offset, std::int64_t expected, std::int64_t x);
 
+    /// Write the region out to the file (msync) - wait for the write unless async
+    void flush(bool async = false) { m_region.flush(0, 0, async); }
+
     /// Align the position in the region to a value divisible by the given parameter
     void align_position(std::int32_t value);
 
@@ -123,6 +128,14 @@ void region::write_ordered32(std::int32_t offset, std::int32_t value)
     __atomic_store_n(ptr, value, __ATOMIC_RELAXED);
 }
 
+BOOST_FORCEINLINE
+void region::write_ordered64(std::int32_t offset, std::int64_t value)
+{
+    assert((offset & 7) == 0);
+    auto * ptr = reinterpret_cast<volatile std::int64_t *>(data() + offset);
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
 BOOST_FORCEINLINE
 bool region::cas64(std::int32_t offset, std::int64_t expect, std::int64_t update)
 {
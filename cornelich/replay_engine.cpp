@@ -0,0 +1,295 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "replay_engine.h"
+
+#include "vanilla_chronicle.h"
+#include "util/math_util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace cornelich
+{
+
+namespace
+{
+
+/// How many excerpts a worker fetches at once
+constexpr std::size_t BATCH_SIZE = 256;
+/// How many blocks (per worker) for_each_ordered() reads ahead
+constexpr std::size_t BLOCKS_AHEAD = 2;
+
+/// The first exception thrown by any of the threads - the others stop when there is one
+class first_error
+{
+public:
+    first_error() : m_failed(false) {}
+
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+    void set(std::exception_ptr error)
+    {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if(!m_error)
+            m_error = error;
+        m_failed = true;
+    }
+
+    void rethrow()
+    {
+        if(m_error)
+            std::rethrow_exception(m_error);
+    }
+
+private:
+    std::atomic<bool> m_failed;
+    std::mutex m_lock;
+    std::exception_ptr m_error;
+};
+
+}
+
+replay_engine::replay_engine(vanilla_chronicle & chronicle, std::size_t thread_count, std::size_t block_entries)
+    : m_chronicle(chronicle)
+    , m_thread_count(thread_count)
+    , m_block_entries(block_entries)
+{
+    if(!thread_count)
+        throw std::invalid_argument("At least one thread is needed");
+    if(!block_entries)
+        throw std::invalid_argument("A block needs at least one entry");
+}
+
+std::vector<replay_engine::block> replay_engine::blocks(std::int64_t from, std::int64_t to) const
+{
+    std::vector<block> result;
+    if(from >= to)
+        return result;
+
+    const auto from_cycle = static_cast<std::int32_t>(util::right_shift(from, m_chronicle.m_entries_for_cycle_bits));
+    const auto to_cycle = static_cast<std::int32_t>(util::right_shift(to - 1, m_chronicle.m_entries_for_cycle_bits));
+    for(auto cycle : m_chronicle.m_directory.cycles())
+    {
+        if(cycle < from_cycle || cycle > to_cycle)
+            continue;
+        const auto cycle_start = static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits;
+        const auto last_file = m_chronicle.m_index.last_index_file_number(cycle, -1);
+        for(std::int64_t file = 0; file <= last_file; ++file)
+        {
+            const auto file_start = cycle_start + (file << m_chronicle.m_index_block_longs_bits);
+            const auto file_end = file_start + m_chronicle.m_index_block_longs_mask + 1;
+            const auto end = std::min(to, file_end);
+            for(auto start = std::max(from, file_start); start < end; start += static_cast<std::int64_t>(m_block_entries))
+                result.push_back({start, std::min(end, start + static_cast<std::int64_t>(m_block_entries))});
+        }
+    }
+    return result;
+}
+
+template <typename DELIVER, typename KEEP_REGIONS>
+std::size_t replay_engine::replay_block(excerpt_tailer & tailer, const block & b, DELIVER && deliver, KEEP_REGIONS && keep_regions)
+{
+    // The entries of an index file are contiguous - so a missing first one means an empty rest of the file
+    if(!tailer.index(b.start))
+        return 0;
+    deliver(excerpt_view{tailer.index(), tailer.buffer().data(), tailer.limit()});
+    keep_regions(util::array_view<const region_ptr>(&tailer.data_region(), 1));
+    std::size_t count = 1;
+
+    while(tailer.index() + 1 < b.end)
+    {
+        const auto left = static_cast<std::size_t>(b.end - tailer.index() - 1);
+        auto batch = tailer.next_batch(std::min(BATCH_SIZE, left));
+        if(batch.empty())
+            break;
+        keep_regions(tailer.batch_regions());
+        for(auto && view : batch)
+        {
+            // next_batch() moves on to the next index file when this one has no more entries
+            if(view.index >= b.end)
+                return count;
+            deliver(view);
+            ++count;
+        }
+    }
+    return count;
+}
+
+std::size_t replay_engine::for_each(std::int64_t from, std::int64_t to, const handler_t & handler)
+{
+    const auto all_blocks = blocks(from, to);
+    std::atomic<std::size_t> next_block(0);
+    std::atomic<std::size_t> total(0);
+    first_error error;
+
+    auto worker = [&]()
+    {
+        try
+        {
+            auto tailer = m_chronicle.create_tailer();
+            std::size_t count = 0;
+            while(!error.failed())
+            {
+                const auto b = next_block.fetch_add(1, std::memory_order_relaxed);
+                if(b >= all_blocks.size())
+                    break;
+                count += replay_block(tailer, all_blocks[b], handler, [](util::array_view<const region_ptr>) {});
+            }
+            total += count;
+        }
+        catch(...)
+        {
+            error.set(std::current_exception());
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i != std::min(m_thread_count, all_blocks.size()); ++i)
+        threads.emplace_back(worker);
+    for(auto && t : threads)
+        t.join();
+
+    error.rethrow();
+    return total;
+}
+
+std::size_t replay_engine::for_each_ordered(std::int64_t from, std::int64_t to, const handler_t & handler)
+{
+    const auto all_blocks = blocks(from, to);
+
+    // A block read by a worker - the views together with the regions they point to
+    struct block_result
+    {
+        bool ready = false;
+        std::vector<excerpt_view> views;
+        std::vector<region_ptr> regions;
+    };
+    std::vector<block_result> results(all_blocks.size());
+    const auto window = m_thread_count * BLOCKS_AHEAD;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::size_t next_block = 0;
+    std::size_t delivered = 0;
+    first_error error;
+
+    auto worker = [&]()
+    {
+        try
+        {
+            auto tailer = m_chronicle.create_tailer();
+            while(true)
+            {
+                std::size_t b;
+                {
+                    // Do not read too far ahead of the delivery
+                    std::unique_lock<std::mutex> lk(lock);
+                    changed.wait(lk, [&]() { return error.failed() || next_block >= all_blocks.size() || next_block < delivered + window; });
+                    if(error.failed() || next_block >= all_blocks.size())
+                        break;
+                    b = next_block++;
+                }
+
+                block_result result;
+                replay_block(tailer, all_blocks[b], [&result](const excerpt_view & view)
+                {
+                    result.views.push_back(view);
+                },
+                [&result](util::array_view<const region_ptr> regions)
+                {
+                    // Keep the views valid until they are delivered
+                    for(auto && region : regions)
+                    {
+                        if(result.regions.empty() || result.regions.back() != region)
+                            result.regions.push_back(region);
+                    }
+                });
+
+                std::lock_guard<std::mutex> lk(lock);
+                result.ready = true;
+                results[b] = std::move(result);
+                changed.notify_all();
+            }
+        }
+        catch(...)
+        {
+            error.set(std::current_exception());
+            std::lock_guard<std::mutex> lk(lock);
+            changed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i != std::min(m_thread_count, all_blocks.size()); ++i)
+        threads.emplace_back(worker);
+
+    std::size_t total = 0;
+    try
+    {
+        for(std::size_t b = 0; b != all_blocks.size(); ++b)
+        {
+            block_result result;
+            {
+                std::unique_lock<std::mutex> lk(lock);
+                changed.wait(lk, [&]() { return error.failed() || results[b].ready; });
+                if(!results[b].ready)
+                    break;
+                result = std::move(results[b]);
+            }
+
+            for(auto && view : result.views)
+                handler(view);
+            total += result.views.size();
+
+            std::lock_guard<std::mutex> lk(lock);
+            ++delivered;
+            changed.notify_all();
+        }
+    }
+    catch(...)
+    {
+        error.set(std::current_exception());
+        std::lock_guard<std::mutex> lk(lock);
+        changed.notify_all();
+    }
+
+    for(auto && t : threads)
+        t.join();
+
+    error.rethrow();
+    return total;
+}
+
+std::size_t replay_engine::for_each_in_cycle(std::int32_t cycle, const handler_t & handler)
+{
+    const auto start = static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits;
+    return for_each(start, start + m_chronicle.m_entries_for_cycle_mask + 1, handler);
+}
+
+std::size_t replay_engine::for_each_in_cycle_ordered(std::int32_t cycle, const handler_t & handler)
+{
+    const auto start = static_cast<std::int64_t>(cycle) << m_chronicle.m_entries_for_cycle_bits;
+    return for_each_ordered(start, start + m_chronicle.m_entries_for_cycle_mask + 1, handler);
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "excerpt_tailer.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cornelich
+{
+
+class vanilla_chronicle;
+
+/**
+ * Replays a range of a chronicle on several threads.
+ *
+ * The range is split into blocks - the part of the range covered by one index file, cut to at most
+ * block_entries() entries - and the worker threads (each with its own tailer) take the blocks one by one. for_each() hands the excerpts to the handler
+ * straight from the workers: concurrently, in index order within a block only. for_each_ordered() has the
+ * workers read the blocks ahead and hands the excerpts to the handler on the calling thread in index order:
+ * it holds up to 2 * thread_count() blocks of block_entries() views (24 bytes each) at a time.
+ *
+ * The views are only valid during the handler call. An exception thrown by the handler stops the replay
+ * and is rethrown by for_each() / for_each_ordered().
+ */
+class replay_engine
+{
+public:
+    using handler_t = std::function<void(const excerpt_view &)>;
+
+    /// Default maximal number of entries in a block - 1.5 MB of views per block read ahead by for_each_ordered()
+    static constexpr std::size_t DEFAULT_BLOCK_ENTRIES = 65536;
+
+    /// Create an engine using the given number of worker threads and blocks of up to block_entries entries
+    replay_engine(vanilla_chronicle & chronicle, std::size_t thread_count, std::size_t block_entries = DEFAULT_BLOCK_ENTRIES);
+
+    std::size_t thread_count() const { return m_thread_count; }
+    std::size_t block_entries() const { return m_block_entries; }
+
+    /// Replay the excerpts with indices in [from, to) - concurrently. Return the number of excerpts replayed.
+    std::size_t for_each(std::int64_t from, std::int64_t to, const handler_t & handler);
+    /// Replay the excerpts with indices in [from, to) - in index order on the calling thread.
+    /// Return the number of excerpts replayed.
+    std::size_t for_each_ordered(std::int64_t from, std::int64_t to, const handler_t & handler);
+
+    /// Replay a whole cycle concurrently
+    std::size_t for_each_in_cycle(std::int32_t cycle, const handler_t & handler);
+    /// Replay a whole cycle in index order
+    std::size_t for_each_in_cycle_ordered(std::int32_t cycle, const handler_t & handler);
+
+private:
+    /// The part of the range covered by one index file (or a part of it)
+    struct block
+    {
+        std::int64_t start;
+        std::int64_t end;
+    };
+
+    /// Split [from, to) into the blocks of the existing index files - of up to block_entries() entries
+    std::vector<block> blocks(std::int64_t from, std::int64_t to) const;
+    /**
+     * Pass the excerpts of the block to deliver() - return the number of them.
+     * keep_regions() gets the data regions of the excerpts delivered since its previous call (the tailer
+     * only holds on to them until it moves on).
+     */
+    template <typename DELIVER, typename KEEP_REGIONS>
+    static std::size_t replay_block(excerpt_tailer & tailer, const block & b, DELIVER && deliver, KEEP_REGIONS && keep_regions);
+
+    vanilla_chronicle & m_chronicle;
+    const std::size_t m_thread_count;
+    const std::size_t m_block_entries;
+};
+
+}
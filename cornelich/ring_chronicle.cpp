@@ -0,0 +1,280 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "ring_chronicle.h"
+
+#include "util/spin_lock.h"
+#include "util/streamer.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+namespace
+{
+
+std::int32_t slot_stride(std::int32_t slots, std::int32_t slot_size)
+{
+    if(slots <= 0 || (slots & (slots - 1)) != 0)
+        throw std::invalid_argument(util::streamer() << "Number of ring slots must be a power of 2: " << slots);
+    if(slot_size <= 0)
+        throw std::invalid_argument(util::streamer() << "Invalid ring slot size: " << slot_size);
+    const auto stride = (static_cast<std::int64_t>(slot_size) + 16 + 7) & ~7LL;
+    if(128 + stride * slots > std::numeric_limits<std::int32_t>::max())
+        throw std::invalid_argument(util::streamer() << "Ring too big: " << slots << " slots of " << slot_size << " bytes");
+    return static_cast<std::int32_t>(stride);
+}
+
+std::string ring_file(const std::string & path)
+{
+    const auto parent = boost::filesystem::path(path).parent_path();
+    if(!parent.empty())
+        boost::filesystem::create_directories(parent);
+    return path;
+}
+
+}
+
+constexpr std::int64_t ring_chronicle::MAGIC;
+constexpr std::int64_t ring_chronicle::INITIALISING;
+constexpr std::int32_t ring_chronicle::MAGIC_OFFSET;
+constexpr std::int32_t ring_chronicle::SLOTS_OFFSET;
+constexpr std::int32_t ring_chronicle::SLOT_SIZE_OFFSET;
+constexpr std::int32_t ring_chronicle::CLAIMED_OFFSET;
+constexpr std::int32_t ring_chronicle::SLOTS_START;
+constexpr std::int32_t ring_chronicle::SLOT_HEADER;
+
+ring_chronicle::ring_chronicle(const std::string & path, std::int32_t slots, std::int32_t slot_size)
+    : m_slots(slots)
+    , m_slot_size(slot_size)
+    , m_slot_stride(slot_stride(slots, slot_size))
+    , m_mask(slots - 1)
+    , m_region(ring_file(path), static_cast<std::uint32_t>(SLOTS_START + m_slot_stride * slots), 0)
+{
+    // The first one to map the file records the geometry, the others check it
+    if(m_region.cas64(MAGIC_OFFSET, 0, INITIALISING))
+    {
+        m_region.write_ordered64(SLOTS_OFFSET, slots);
+        m_region.write_ordered64(SLOT_SIZE_OFFSET, slot_size);
+        m_region.write_ordered64(MAGIC_OFFSET, MAGIC);
+        return;
+    }
+
+    util::default_backoff<5> backoff;
+    std::int64_t magic;
+    while((magic = m_region.read_ordered64(MAGIC_OFFSET)) == INITIALISING)
+        backoff();
+    if(magic != MAGIC)
+        throw std::runtime_error(util::streamer() << "Not a ring chronicle: " << path);
+
+    const auto existing_slots = m_region.read_ordered64(SLOTS_OFFSET);
+    const auto existing_slot_size = m_region.read_ordered64(SLOT_SIZE_OFFSET);
+    if(existing_slots != slots || existing_slot_size != slot_size)
+        throw std::invalid_argument(util::streamer() << "Ring " << path << " has " << existing_slots << " slots of "
+                                                     << existing_slot_size << " bytes, requested " << slots << " of " << slot_size);
+}
+
+std::string ring_chronicle::shm_path(const std::string & name)
+{
+    return (boost::filesystem::path("/dev/shm") / name).string();
+}
+
+ring_appender ring_chronicle::create_appender()
+{
+    return ring_appender(*this);
+}
+
+ring_tailer ring_chronicle::create_tailer()
+{
+    return ring_tailer(*this);
+}
+
+std::int64_t ring_chronicle::claim()
+{
+    return __sync_fetch_and_add(reinterpret_cast<volatile std::int64_t *>(m_region.data() + CLAIMED_OFFSET), 1);
+}
+
+bool ring_chronicle::replace(std::int32_t offset, std::int64_t expected, std::int64_t desired)
+{
+    return __sync_bool_compare_and_swap(reinterpret_cast<volatile std::int64_t *>(m_region.data() + offset), expected, desired);
+}
+
+ring_appender::ring_appender(ring_chronicle & chronicle)
+    : m_chronicle(chronicle)
+    , m_buffer(m_index)
+{
+}
+
+ring_appender::ring_appender(ring_appender && other) noexcept
+    : m_chronicle(other.m_chronicle)
+    , m_slot(other.m_slot)
+    , m_index(other.m_index)
+    , m_last_written_index(other.m_last_written_index)
+    , m_buffer(m_index)
+{
+    // The buffer refers to the index of its owner - rebind it
+    m_buffer.reset(other.m_buffer.data(), other.m_buffer.position(), other.m_buffer.limit());
+    other.m_buffer.reset();
+    other.m_slot = -1;
+}
+
+void ring_appender::start_excerpt(std::int32_t capacity, std::int64_t stall_timeout)
+{
+    if(capacity > m_chronicle.m_slot_size)
+        throw std::invalid_argument(util::streamer() << "Excerpt of " << capacity << " bytes does not fit a ring slot of "
+                                                     << m_chronicle.m_slot_size);
+    if(m_slot >= 0)
+        throw std::logic_error("Excerpt already in progress");
+
+    const auto index = m_chronicle.claim();
+    const auto slot = m_chronicle.slot_offset(index);
+    auto & region = m_chronicle.m_region;
+
+    // The appender of the previous lap may still be writing the slot
+    const auto slots = m_chronicle.m_slots;
+    const auto previous_of = [slots](std::int64_t i) { return i >= slots ? i - slots + 1 : 0; };
+    const auto previous = previous_of(index);
+    util::default_backoff<5> backoff;
+    auto observed = previous;
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    auto marked = false;
+    for(auto sequence = region.read_ordered64(slot); sequence != previous; sequence = region.read_ordered64(slot))
+    {
+        if(std::abs(sequence) > index + 1)
+            throw std::runtime_error(util::streamer() << "Slot of index " << index << " has been taken over by the next lap - "
+                                                      << "the appender stalled for longer than the stall timeout");
+        if(stall_timeout >= 0)
+        {
+            const auto now = std::chrono::steady_clock::now();
+            // The deadline restarts whenever the appender of the previous lap makes progress
+            if(sequence != observed)
+            {
+                observed = sequence;
+                deadline = now + std::chrono::microseconds(stall_timeout);
+            }
+            // Stuck between claim() and finish() - most likely dead, take the slot over
+            const auto stuck = sequence == -(index - slots + 1) || sequence == previous_of(index - slots);
+            if(now >= deadline && stuck && m_chronicle.replace(slot, sequence, -(index + 1)))
+            {
+                marked = true;
+                break;
+            }
+        }
+        backoff();
+    }
+
+    if(!marked)
+        region.write_ordered64(slot, -(index + 1));
+    // The readers of the previous lap must see the mark before any of the new data
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    m_slot = slot;
+    m_index = index;
+    m_buffer.reset(region.data() + slot + ring_chronicle::SLOT_HEADER, 0, capacity);
+}
+
+void ring_appender::finish()
+{
+    if(m_slot < 0)
+        throw std::logic_error("Not started");
+
+    auto & region = m_chronicle.m_region;
+    const auto slot = m_slot;
+    m_slot = -1;
+    if(region.read_ordered64(slot) == -(m_index + 1))
+    {
+        region.write_ordered32(slot + 8, m_buffer.position());
+        if(m_chronicle.replace(slot, -(m_index + 1), m_index + 1))
+        {
+            m_last_written_index = m_index;
+            return;
+        }
+    }
+    throw std::runtime_error(util::streamer() << "Slot of index " << m_index << " has been taken over by the next lap - "
+                                              << "the appender stalled for longer than the stall timeout");
+}
+
+ring_tailer::ring_tailer(ring_chronicle & chronicle)
+    : m_chronicle(chronicle)
+    , m_buffer(m_index)
+{
+    to_start();
+}
+
+ring_tailer::ring_tailer(ring_tailer && other) noexcept
+    : m_chronicle(other.m_chronicle)
+    , m_slot(other.m_slot)
+    , m_index(other.m_index)
+    , m_next(other.m_next)
+    , m_lost(other.m_lost)
+    , m_buffer(m_index)
+{
+    // The buffer refers to the index of its owner - rebind it
+    m_buffer.reset(other.m_buffer.data(), other.m_buffer.position(), other.m_buffer.limit());
+    other.m_buffer.reset();
+}
+
+bool ring_tailer::next_index()
+{
+    auto & region = m_chronicle.m_region;
+    while(true)
+    {
+        const auto slot = m_chronicle.slot_offset(m_next);
+        const auto sequence = region.read_ordered64(slot);
+        if(BOOST_LIKELY(sequence == m_next + 1))
+        {
+            m_slot = slot;
+            m_index = m_next++;
+            m_buffer.reset(region.data() + slot + ring_chronicle::SLOT_HEADER, 0, region.read_ordered32(slot + 8));
+            return true;
+        }
+        if(std::abs(sequence) <= m_next + 1)
+            return false;   // not written yet (or still being written)
+
+        // Overwritten - continue with the oldest excerpt which can still be in the ring
+        const auto oldest = std::max(m_next + 1, m_chronicle.claimed() - m_chronicle.m_slots);
+        m_lost += static_cast<std::uint64_t>(oldest - m_next);
+        m_next = oldest;
+    }
+}
+
+bool ring_tailer::valid() const
+{
+    if(m_slot < 0)
+        return false;
+    // The reads of the excerpt must not be moved after the check
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return m_chronicle.m_region.read_ordered64(m_slot) == m_index + 1;
+}
+
+void ring_tailer::to_start()
+{
+    m_next = std::max<std::int64_t>(0, m_chronicle.claimed() - m_chronicle.m_slots);
+}
+
+void ring_tailer::to_end()
+{
+    m_next = m_chronicle.claimed();
+}
+
+}
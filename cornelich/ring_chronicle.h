@@ -0,0 +1,245 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "region.h"
+#include "util/buffer_view.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace cornelich
+{
+
+class ring_appender;
+class ring_tailer;
+
+/**
+ * A fixed-size ring of excerpts in a single memory mapped file - meant for /dev/shm (see shm_path()) and
+ * the lowest latency IPC between the processes of one host.
+ *
+ * Unlike vanilla_chronicle nothing is created, scanned or rolled while running: the file is mapped
+ * once in the constructor, the excerpts are written to slots of a fixed size and a slow reader
+ * loses the excerpts which have been overwritten (see ring_tailer::lost()).
+ *
+ * The layout of the file:
+ * - [0]   magic         - set once the file has been initialised
+ * - [8]   slots         - number of slots (a power of 2)
+ * - [16]  slot size     - maximal length of an excerpt
+ * - [64]  claimed       - number of indices handed out to the appenders so far
+ * - [128] slots         - [sequence:8][length:4][padding:4][data:slot size rounded up to 8]
+ *
+ * The sequence of a slot is index + 1 once the excerpt has been written and -(index + 1) while it is
+ * being written, so a reader can tell an excerpt it expects from the one that has overwritten it.
+ *
+ * An appender which dies between claiming an index and finishing its excerpt leaves the slot unfinished:
+ * the readers wait at that index and the appender of the next lap waits for the slot. After the stall
+ * timeout of ring_appender::start_excerpt() the appender of the next lap takes the slot over, the readers
+ * then skip the abandoned excerpt and count it in ring_tailer::lost().
+ */
+class ring_chronicle
+{
+public:
+    /**
+     * Map (create if it does not exist) the ring at the given path.
+     * An existing ring must have been created with the same slots and slot_size.
+     * @param path Location of the file (see shm_path())
+     * @param slots Number of excerpts kept in the ring - a power of 2
+     * @param slot_size Maximal length of an excerpt
+     */
+    ring_chronicle(const std::string & path, std::int32_t slots, std::int32_t slot_size);
+
+    ring_chronicle(const ring_chronicle &) = delete;
+    ring_chronicle & operator=(const ring_chronicle &) = delete;
+
+    /// The location of a ring with the given name in the shared memory file system
+    static std::string shm_path(const std::string & name);
+
+    std::string path() const { return m_region.path(); }
+    std::int32_t slots() const { return m_slots; }
+    std::int32_t slot_size() const { return m_slot_size; }
+
+    /// The highest index handed out to an appender (-1 if none) - it may still be being written
+    std::int64_t last_index() const { return claimed() - 1; }
+
+    ring_appender create_appender();
+    ring_tailer create_tailer();
+
+private:
+    friend class ring_appender;
+    friend class ring_tailer;
+
+    static constexpr std::int64_t MAGIC = 0x676e6972686c6f63;   // "colhring"
+    static constexpr std::int64_t INITIALISING = -1;
+    static constexpr std::int32_t MAGIC_OFFSET = 0;
+    static constexpr std::int32_t SLOTS_OFFSET = 8;
+    static constexpr std::int32_t SLOT_SIZE_OFFSET = 16;
+    static constexpr std::int32_t CLAIMED_OFFSET = 64;
+    static constexpr std::int32_t SLOTS_START = 128;
+    static constexpr std::int32_t SLOT_HEADER = 16;
+
+    std::int64_t claimed() const { return m_region.read_ordered64(CLAIMED_OFFSET); }
+    /// Hand out the next index
+    std::int64_t claim();
+    /// Atomically replace the 64 bit value at offset if it is still expected
+    bool replace(std::int32_t offset, std::int64_t expected, std::int64_t desired);
+    /// Offset of the slot of an index
+    std::int32_t slot_offset(std::int64_t index) const { return SLOTS_START + static_cast<std::int32_t>(index & m_mask) * m_slot_stride; }
+
+    const std::int32_t m_slots;
+    const std::int32_t m_slot_size;
+    const std::int32_t m_slot_stride;
+    const std::int64_t m_mask;
+    region m_region;
+};
+
+/// Writes excerpts to a ring_chronicle - can be used by one thread at a time, any number of appenders may share a ring
+class ring_appender
+{
+public:
+    explicit ring_appender(ring_chronicle & chronicle);
+
+    ring_appender(ring_appender && other) noexcept;
+    ring_appender(const ring_appender &) = delete;
+    ring_appender & operator=(const ring_appender &) = delete;
+
+    /// Index of the excerpt in progress (or the last one finished)
+    std::int64_t index() const { return m_index; }
+    std::int64_t last_written_index() const { return m_last_written_index; }
+
+    /// How long (in microseconds) an appender of the previous lap may hold a slot before it is taken over
+    static constexpr std::int64_t DEFAULT_STALL_TIMEOUT = 1000000;
+
+    /**
+     * Claim the next index and start an excerpt of up to capacity (at most ring_chronicle::slot_size()) bytes.
+     * Waits if the slot is still being written by the appender of the previous lap. If that appender makes
+     * no progress for stall_timeout microseconds (a negative timeout waits forever) it is assumed dead and
+     * the slot is taken over. Throws std::runtime_error if this appender stalled so long that its own slot
+     * has been taken over in the meantime.
+     */
+    void start_excerpt(std::int32_t capacity, std::int64_t stall_timeout = DEFAULT_STALL_TIMEOUT);
+    /**
+     * Publish the excerpt in progress. Throws std::runtime_error if the slot has been taken over by the
+     * appender of the next lap - the excerpt is lost.
+     */
+    void finish();
+
+    util::buffer_view & buffer() { return m_buffer; }
+    const util::buffer_view & buffer() const { return m_buffer; }
+
+    template <typename T>
+    void write(T val);
+    template <typename T, typename WRITER>
+    void write(T && val, WRITER && wrt);
+
+private:
+    ring_chronicle & m_chronicle;
+    std::int32_t m_slot = -1;
+    std::int64_t m_index = -1;
+    std::int64_t m_last_written_index = -1;
+    util::buffer_view m_buffer;
+};
+
+/// Reads the excerpts of a ring_chronicle in the index order
+class ring_tailer
+{
+public:
+    /// Create a tailer positioned at the oldest excerpt still in the ring
+    explicit ring_tailer(ring_chronicle & chronicle);
+
+    ring_tailer(ring_tailer && other) noexcept;
+    ring_tailer(const ring_tailer &) = delete;
+    ring_tailer & operator=(const ring_tailer &) = delete;
+
+    /**
+     * Move to the next excerpt. Return false if it has not been written yet.
+     * The excerpts overwritten before they could be read are skipped and counted in lost().
+     */
+    bool next_index();
+
+    /// Index of the current excerpt (-1 before the first next_index())
+    std::int64_t index() const { return m_index; }
+
+    /**
+     * Whether the current excerpt is still intact - an excerpt may be overwritten while being read if
+     * the reader is a whole ring behind the appenders. To be checked after the excerpt has been read.
+     */
+    bool valid() const;
+
+    /// Number of excerpts skipped because they were overwritten before they were read
+    std::uint64_t lost() const { return m_lost; }
+
+    /// Move to the oldest excerpt still in the ring
+    void to_start();
+    /// Move after the last excerpt claimed so far
+    void to_end();
+
+    util::buffer_view & buffer() { return m_buffer; }
+    const util::buffer_view & buffer() const { return m_buffer; }
+
+    /// Length of the current excerpt
+    std::int32_t limit() const { return m_buffer.limit(); }
+
+    template <typename T>
+    T read();
+    template <typename READER>
+    typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type read(READER && rdr);
+
+private:
+    ring_chronicle & m_chronicle;
+    std::int32_t m_slot = -1;
+    std::int64_t m_index = -1;
+    std::int64_t m_next = 0;
+    std::uint64_t m_lost = 0;
+    util::buffer_view m_buffer;
+};
+
+template<typename T>
+BOOST_FORCEINLINE void ring_appender::write(T val)
+{
+    static_assert(std::is_pod<T>::value, "ring_appender::write(): POD expected for T");
+    std::memcpy(m_buffer.data() + m_buffer.position(), &val, sizeof(T));
+    m_buffer.position() += static_cast<std::int32_t>(sizeof(T));
+}
+
+template <typename T, typename WRITER>
+BOOST_FORCEINLINE void ring_appender::write(T && val, WRITER && wrt)
+{
+    wrt(m_buffer.data(), m_buffer.position(), std::forward<T>(val));
+}
+
+template<typename T>
+BOOST_FORCEINLINE T ring_tailer::read()
+{
+    static_assert(std::is_pod<T>::value, "ring_tailer::read(): POD expected for T");
+    T val;
+    std::memcpy(&val, m_buffer.data() + m_buffer.position(), sizeof(T));
+    m_buffer.position() += static_cast<std::int32_t>(sizeof(T));
+    return val;
+}
+
+template <typename READER>
+BOOST_FORCEINLINE typename std::result_of<READER(std::uint8_t*, std::int32_t&)>::type ring_tailer::read(READER && rdr)
+{
+    return rdr(m_buffer.data(), m_buffer.position());
+}
+
+}
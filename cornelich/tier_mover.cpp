@@ -0,0 +1,255 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "tier_mover.h"
+
+#include "vanilla_date.h"
+#include "vanilla_utils.h"
+
+#include "util/streamer.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+namespace cornelich
+{
+
+namespace
+{
+
+/// Write the file (or directory) out to the disk
+void sync(const fs::path & path)
+{
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "open " << path.string());
+    const auto result = ::fsync(fd);
+    const auto error = errno;
+    ::close(fd);
+    if(result != 0)
+        throw std::system_error(error, std::system_category(), util::streamer() << "fsync " << path.string());
+}
+
+/// Closes a file descriptor when leaving the scope
+struct fd_closer
+{
+    ~fd_closer() { if(fd >= 0) ::close(fd); }
+    int fd;
+};
+
+/**
+ * Copy a file leaving its holes as holes: the data and index files are sparse (created at their full size
+ * and filled as the excerpts come), so only the extents with data are copied and the copy is truncated
+ * to the size of the original.
+ */
+void copy_sparse(const fs::path & from, const fs::path & to)
+{
+    const fd_closer source{::open(from.c_str(), O_RDONLY | O_CLOEXEC)};
+    if(source.fd < 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "open " << from.string());
+    struct stat st;
+    if(::fstat(source.fd, &st) != 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "fstat " << from.string());
+    const fd_closer target{::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777)};
+    if(target.fd < 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "open " << to.string());
+    if(::ftruncate(target.fd, st.st_size) != 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "ftruncate " << to.string());
+
+    std::vector<char> buffer(1 << 20);
+    off_t data = 0;
+    while(data < st.st_size)
+    {
+        data = ::lseek(source.fd, data, SEEK_DATA);
+        if(data < 0)
+        {
+            if(errno == ENXIO)
+                break;  // only a hole up to the end
+            throw std::system_error(errno, std::system_category(), util::streamer() << "lseek " << from.string());
+        }
+        const auto hole = ::lseek(source.fd, data, SEEK_HOLE);
+        if(hole < 0)
+            throw std::system_error(errno, std::system_category(), util::streamer() << "lseek " << from.string());
+        while(data < hole)
+        {
+            const auto length = std::min<off_t>(hole - data, static_cast<off_t>(buffer.size()));
+            const auto read = ::pread(source.fd, buffer.data(), static_cast<std::size_t>(length), data);
+            if(read <= 0)
+            {
+                if(read < 0 && errno == EINTR)
+                    continue;
+                throw std::system_error(read < 0 ? errno : EIO, std::system_category(), util::streamer() << "read " << from.string());
+            }
+            for(ssize_t written = 0; written < read;)
+            {
+                const auto result = ::pwrite(target.fd, buffer.data() + written, static_cast<std::size_t>(read - written), data + written);
+                if(result < 0)
+                {
+                    if(errno == EINTR)
+                        continue;
+                    throw std::system_error(errno, std::system_category(), util::streamer() << "write " << to.string());
+                }
+                written += result;
+            }
+            data += read;
+        }
+    }
+}
+
+}
+
+tier_mover::tier_mover(const vanilla_chronicle_settings & settings, std::int32_t keep_cycles)
+    : m_settings(settings)
+    , m_keep_cycles(keep_cycles)
+    , m_moved(0)
+    , m_running(false)
+{
+    if(settings.active_path().empty())
+        throw std::invalid_argument(util::streamer() << "No active tier for chronicle " << settings.path());
+    if(keep_cycles < 2)
+        throw std::invalid_argument(util::streamer() << "The current and the previous cycle have to stay in the active tier, keep_cycles: "
+                                                     << keep_cycles);
+}
+
+tier_mover::~tier_mover()
+{
+    join();
+}
+
+std::size_t tier_mover::move_closed()
+{
+    const auto last_closed = cycle_for_now(m_settings.cycle_length()) - m_keep_cycles;
+    std::vector<std::string> closed;
+    boost::system::error_code err;
+    fs::directory_iterator begin(m_settings.active_path(), err);
+    fs::directory_iterator end;
+    for(const auto & entry : boost::make_iterator_range(begin, end))
+    {
+        auto name = entry.path().filename().string();
+        const auto cycle = m_settings.cycle_format().cycle_from_date(name);
+        if(cycle >= 0 && cycle <= last_closed && fs::is_directory(entry))
+            closed.push_back(std::move(name));
+    }
+
+    std::size_t moved = 0;
+    for(auto && cycle_string : closed)
+        moved += move_cycle(cycle_string);
+    m_moved.fetch_add(moved, std::memory_order_acq_rel);
+    return moved;
+}
+
+std::size_t tier_mover::move_cycle(const std::string & cycle_string)
+{
+    const auto from = fs::path(m_settings.active_path()) / cycle_string;
+    const auto to = fs::path(m_settings.path()) / cycle_string;
+    fs::create_directories(to);
+
+    std::vector<fs::path> files;
+    for(const auto & entry : boost::make_iterator_range(fs::directory_iterator(from), fs::directory_iterator()))
+    {
+        if(fs::is_regular_file(entry))
+            files.push_back(entry.path());
+    }
+
+    std::size_t moved = 0;
+    for(auto && file : files)
+    {
+        const auto target = to / file.filename();
+        if(fs::exists(target))
+        {
+            // Moved by an earlier pass - nobody can be about to map this copy any more
+            fs::remove(file);
+            continue;
+        }
+        // Hidden from the readers until complete (see make_file())
+        const auto temporary = to / ("." + file.filename().string() + ".moving");
+        copy_sparse(file, temporary);
+        sync(temporary);
+        fs::rename(temporary, target);
+        ++moved;
+    }
+
+    if(moved)
+        sync(to);
+    else if(fs::is_empty(from))
+        fs::remove(from);
+    return moved;
+}
+
+void tier_mover::start(std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lk(m_lock);
+    if(m_thread.joinable())
+        throw std::logic_error("tier_mover already started");
+    m_running = true;
+    m_error = nullptr;
+    m_thread = std::thread([this, interval]() { run(interval); });
+}
+
+void tier_mover::stop()
+{
+    join();
+    std::lock_guard<std::mutex> lk(m_lock);
+    if(m_error)
+        std::rethrow_exception(m_error);
+}
+
+void tier_mover::run(std::chrono::milliseconds interval)
+{
+    std::unique_lock<std::mutex> lk(m_lock);
+    while(m_running)
+    {
+        lk.unlock();
+        try
+        {
+            move_closed();
+        }
+        catch(...)
+        {
+            lk.lock();
+            m_error = std::current_exception();
+            m_running = false;
+            return;
+        }
+        lk.lock();
+        m_stop_requested.wait_for(lk, interval, [this]() { return !m_running; });
+    }
+}
+
+void tier_mover::join()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_lock);
+        m_running = false;
+    }
+    m_stop_requested.notify_all();
+    if(m_thread.joinable())
+        m_thread.join();
+}
+
+}
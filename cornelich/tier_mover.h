@@ -0,0 +1,90 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "vanilla_chronicle_settings.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cornelich
+{
+
+/**
+ * Moves the closed cycles of a chronicle with an active tier (see vanilla_chronicle_settings::active_path())
+ * to the base path - on a background thread (see start()) or on demand (see move_closed()).
+ *
+ * Each file is copied next to its destination under a temporary name (only its data - the holes of the
+ * sparse files stay holes), synced and renamed into place, so the readers find it at the base path
+ * (see make_file()) only once it is complete. Its copy in the
+ * active tier is removed by the next pass - a reader which has just found it there can still map it.
+ * The regions mapped from the removed files stay valid.
+ */
+class tier_mover
+{
+public:
+    /**
+     * @param settings Settings of the chronicle (must have the active tier)
+     * @param keep_cycles Number of the most recent cycles left in the active tier - at least 2: the current
+     *                    cycle and the previous one, which the appenders may still be finishing
+     */
+    explicit tier_mover(const vanilla_chronicle_settings & settings, std::int32_t keep_cycles = 2);
+
+    /// Stop without rethrowing the error of the background thread
+    ~tier_mover();
+
+    tier_mover(const tier_mover &) = delete;
+    tier_mover & operator=(const tier_mover &) = delete;
+
+    /// Move the files of the closed cycles found in the active tier. Return the number of files moved.
+    std::size_t move_closed();
+
+    /// Number of files moved so far
+    std::uint64_t moved() const { return m_moved.load(std::memory_order_acquire); }
+
+    /// Call move_closed() on a background thread every interval until stop()
+    void start(std::chrono::milliseconds interval);
+
+    /// Stop the background thread. Rethrow the exception which has stopped it (if any).
+    void stop();
+
+private:
+    /// Move the files of one cycle directory - return the number of files moved
+    std::size_t move_cycle(const std::string & cycle_string);
+    void run(std::chrono::milliseconds interval);
+    void join();
+
+    const vanilla_chronicle_settings m_settings;
+    const std::int32_t m_keep_cycles;
+    std::atomic<std::uint64_t> m_moved;
+
+    std::mutex m_lock;
+    std::condition_variable m_stop_requested;
+    bool m_running;
+    std::exception_ptr m_error;
+    std::thread m_thread;
+};
+
+}
@@ -0,0 +1,60 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+
+namespace cornelich
+{
+namespace util
+{
+
+/** A non-owning view of a contiguous sequence of T (pointer + size) */
+template<typename T>
+class array_view
+{
+public:
+    using value_type = T;
+    using iterator = T *;
+
+    array_view() : m_data(nullptr), m_size(0) {}
+    array_view(T * data, std::size_t size) : m_data(data), m_size(size) {}
+    /// A view of a whole container with contiguous storage (e.g. std::vector)
+    template<typename C, typename = decltype(std::declval<C &>().data() + std::declval<C &>().size())>
+    array_view(C & container) : m_data(container.data()), m_size(container.size()) {}
+
+    T * data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() const { return m_data; }
+    iterator end() const { return m_data + m_size; }
+
+    T & operator[](std::size_t i) const { assert(i < m_size); return m_data[i]; }
+    T & front() const { assert(m_size); return m_data[0]; }
+    T & back() const { assert(m_size); return m_data[m_size - 1]; }
+
+private:
+    T * m_data;
+    std::size_t m_size;
+};
+
+}
+}
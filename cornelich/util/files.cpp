@@ -21,9 +21,15 @@ limitations under the License.
 
 #include <boost/filesystem.hpp>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
 #include <fstream>
 #include <stdexcept>
+#include <system_error>
 
 namespace bip = boost::interprocess;
 namespace fs = boost::filesystem;
@@ -58,5 +64,51 @@ bip::file_mapping create_mapping(const std::string & path, std::uint32_t size)
 }
 
 
+namespace
+{
+
+/// Return the locked descriptor of the file or -1 if the non-blocking lock is held by somebody else
+int lock_file(const std::string & path, int operation)
+{
+    const auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0)
+        throw std::system_error(errno, std::system_category(), util::streamer() << "open " << path);
+    int result;
+    while((result = ::flock(fd, operation)) != 0 && errno == EINTR);
+    if(result != 0)
+    {
+        const auto error = errno;
+        ::close(fd);
+        if(error == EWOULDBLOCK)
+            return -1;
+        throw std::system_error(error, std::system_category(), util::streamer() << "flock " << path);
+    }
+    return fd;
+}
+
+}
+
+std::unique_ptr<file_lock> file_lock::try_lock(const std::string & path)
+{
+    const auto fd = lock_file(path, LOCK_EX | LOCK_NB);
+    return fd < 0 ? nullptr : std::unique_ptr<file_lock>(new file_lock(fd));
+}
+
+std::unique_ptr<file_lock> file_lock::lock(const std::string & path)
+{
+    return std::unique_ptr<file_lock>(new file_lock(lock_file(path, LOCK_EX)));
+}
+
+std::unique_ptr<file_lock> file_lock::lock_shared(const std::string & path)
+{
+    return std::unique_ptr<file_lock>(new file_lock(lock_file(path, LOCK_SH)));
+}
+
+file_lock::~file_lock()
+{
+    // Closing the descriptor releases the lock
+    ::close(m_fd);
+}
+
 }
 }
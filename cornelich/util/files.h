@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <boost/interprocess/file_mapping.hpp>
 
+#include <memory>
 #include <string>
 
 namespace cornelich
@@ -36,5 +37,29 @@ void touch(const std::string & path);
  */
 boost::interprocess::file_mapping create_mapping(const std::string & path, std::uint32_t size);
 
+/**
+ * An exclusive (or shared) lock (flock) on a file - held until destroyed or until the process dies.
+ * Unlike the POSIX record locks it excludes the other holders in the same process too.
+ */
+class file_lock
+{
+public:
+    /// Lock the file (created if it does not exist). Return nullptr if somebody holds it already.
+    static std::unique_ptr<file_lock> try_lock(const std::string & path);
+    /// Lock the file (created if it does not exist) - wait while somebody holds it
+    static std::unique_ptr<file_lock> lock(const std::string & path);
+    /// Lock the file (created if it does not exist) shared with the other shared holders - wait while somebody holds it exclusively
+    static std::unique_ptr<file_lock> lock_shared(const std::string & path);
+    ~file_lock();
+
+    file_lock(const file_lock &) = delete;
+    file_lock & operator=(const file_lock &) = delete;
+
+private:
+    explicit file_lock(int fd) : m_fd(fd) {}
+
+    const int m_fd;
+};
+
 }
 }
@@ -0,0 +1,66 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "spin_lock.h"
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include <sched.h>
+
+namespace cornelich
+{
+namespace util
+{
+
+/*
+ * Idle strategies - what a thread does between two checks for something that has not happened yet.
+ * An idle strategy is called as idle() and keeps its state (e.g. the backoff) until it is recreated.
+ */
+
+/// Keep the CPU - the lowest latency, a full core burnt while waiting
+struct busy_spin_idle
+{
+    void operator()() { wait(1); }
+};
+
+/// Give up the CPU to other threads between the checks
+struct yield_idle
+{
+    void operator()() { sched_yield(); }
+};
+
+/// Spin for increasing periods first, then yield (see default_backoff)
+using backoff_idle = default_backoff<5>;
+
+/// Sleep between the checks
+class sleep_idle
+{
+public:
+    explicit sleep_idle(std::int64_t micros) : m_micros(micros) {}
+
+    void operator()() { std::this_thread::sleep_for(std::chrono::microseconds(m_micros)); }
+
+private:
+    std::int64_t m_micros;
+};
+
+}
+}
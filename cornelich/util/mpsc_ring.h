@@ -0,0 +1,175 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/config.hpp>
+
+namespace cornelich
+{
+namespace util
+{
+
+/**
+ * A bounded, lock-free, multiple-producer single-consumer ring of fixed-size byte slots.
+ *
+ * Every slot carries a sequence number (as in D. Vyukov's bounded queue):
+ * - slot.sequence == position         -> the slot is free for the producer claiming 'position'
+ * - slot.sequence == position + 1     -> the slot has been published and can be consumed
+ * - slot.sequence == position + size  -> the slot has been consumed and is free for the next lap
+ *
+ * Producers: claim() -> write up to slot_size() bytes -> publish()
+ * Consumer:  peek() -> read -> pop()
+ */
+class mpsc_ring
+{
+public:
+    /// Create a ring with the given number of slots (must be a power of 2) each able to hold slot_size bytes
+    mpsc_ring(std::size_t capacity, std::int32_t slot_size);
+
+    mpsc_ring(const mpsc_ring &) = delete;
+    mpsc_ring & operator=(const mpsc_ring &) = delete;
+
+    std::size_t capacity() const { return m_slots.size(); }
+    std::int32_t slot_size() const { return m_slot_size; }
+
+    /// Try to claim a slot. Return the slot memory or nullptr if the ring is full.
+    std::uint8_t * claim(std::uint64_t & sequence);
+
+    /// Make a claimed slot (holding length bytes) visible to the consumer
+    void publish(std::uint64_t sequence, std::int32_t length);
+
+    /// Return the oldest published slot or nullptr if there is none
+    const std::uint8_t * peek(std::uint64_t & sequence, std::int32_t & length) const;
+
+    /// Release the slot returned by peek()
+    void pop();
+
+    /// Number of slots claimed so far (published or not)
+    std::uint64_t claimed() const { return m_enqueue.value.load(std::memory_order_acquire); }
+    /// Number of slots consumed so far
+    std::uint64_t consumed() const { return m_dequeue.value.load(std::memory_order_acquire); }
+    /// End of the run of published slots starting at the consumer - the consumer can get this far without waiting
+    std::uint64_t published() const;
+
+private:
+    struct slot
+    {
+        std::atomic<std::uint64_t> sequence;
+        std::int32_t length;
+    };
+
+    // Keep the producer and the consumer positions on different cache lines
+    struct padded_position
+    {
+        std::atomic<std::uint64_t> value;
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    const std::int32_t m_slot_size;
+    const std::uint64_t m_mask;
+    std::vector<slot> m_slots;
+    std::vector<std::uint8_t> m_data;
+
+    padded_position m_enqueue;
+    padded_position m_dequeue;
+};
+
+inline mpsc_ring::mpsc_ring(std::size_t capacity, std::int32_t slot_size)
+    : m_slot_size(slot_size > 0 ? slot_size : throw std::invalid_argument("mpsc_ring: slot size must be positive"))
+    , m_mask((capacity && !(capacity & (capacity - 1))) ? capacity - 1 : throw std::invalid_argument("mpsc_ring: capacity must be a power of 2"))
+    , m_slots(capacity)
+    , m_data(capacity * static_cast<std::size_t>(slot_size))
+{
+    for(std::size_t i = 0; i != capacity; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    m_enqueue.value.store(0, std::memory_order_relaxed);
+    m_dequeue.value.store(0, std::memory_order_release);
+}
+
+BOOST_FORCEINLINE std::uint8_t * mpsc_ring::claim(std::uint64_t & sequence)
+{
+    auto position = m_enqueue.value.load(std::memory_order_relaxed);
+    while(true)
+    {
+        auto & s = m_slots[position & m_mask];
+        const auto seq = s.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::int64_t>(seq - position);
+        if(diff == 0)
+        {
+            if(m_enqueue.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                sequence = position;
+                return m_data.data() + (position & m_mask) * static_cast<std::uint64_t>(m_slot_size);
+            }
+        }
+        else if(diff < 0)
+        {
+            // The consumer has not released this slot yet
+            return nullptr;
+        }
+        else
+        {
+            position = m_enqueue.value.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+BOOST_FORCEINLINE void mpsc_ring::publish(std::uint64_t sequence, std::int32_t length)
+{
+    assert(length <= m_slot_size);
+    auto & s = m_slots[sequence & m_mask];
+    s.length = length;
+    s.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+BOOST_FORCEINLINE const std::uint8_t * mpsc_ring::peek(std::uint64_t & sequence, std::int32_t & length) const
+{
+    const auto position = m_dequeue.value.load(std::memory_order_relaxed);
+    auto & s = m_slots[position & m_mask];
+    if(s.sequence.load(std::memory_order_acquire) != position + 1)
+        return nullptr;
+    sequence = position;
+    length = s.length;
+    return m_data.data() + (position & m_mask) * static_cast<std::uint64_t>(m_slot_size);
+}
+
+inline std::uint64_t mpsc_ring::published() const
+{
+    auto position = consumed();
+    const auto end = claimed();
+    // A published slot (and a slot consumed meanwhile) is past its claimed sequence
+    while(position != end && static_cast<std::int64_t>(m_slots[position & m_mask].sequence.load(std::memory_order_acquire) - position) > 0)
+        ++position;
+    return position;
+}
+
+BOOST_FORCEINLINE void mpsc_ring::pop()
+{
+    const auto position = m_dequeue.value.load(std::memory_order_relaxed);
+    m_slots[position & m_mask].sequence.store(position + m_mask + 1, std::memory_order_release);
+    m_dequeue.value.store(position + 1, std::memory_order_release);
+}
+
+}
+}
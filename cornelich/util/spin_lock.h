@@ -22,6 +22,8 @@ limitations under the License.
 
 #include <boost/config.hpp>
 
+#include <sched.h>
+
 namespace cornelich
 {
 namespace util
@@ -0,0 +1,129 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/config.hpp>
+
+namespace cornelich
+{
+namespace util
+{
+
+/**
+ * A bounded, lock-free, single-producer single-consumer queue.
+ *
+ * Both sides keep a cached copy of the other side's position so they only touch the shared cache line
+ * when the cached value says the queue is full (producer) or empty (consumer).
+ *
+ * Producer: try_push()
+ * Consumer: front() -> use the element in place -> pop()
+ */
+template <typename T>
+class spsc_queue
+{
+public:
+    /// Create a queue of the given capacity (must be a power of 2)
+    explicit spsc_queue(std::size_t capacity);
+
+    spsc_queue(const spsc_queue &) = delete;
+    spsc_queue & operator=(const spsc_queue &) = delete;
+
+    std::size_t capacity() const { return m_slots.size(); }
+
+    /// Add an element. Return false if the queue is full.
+    bool try_push(T && value);
+    bool try_push(const T & value) { return try_push(T(value)); }
+
+    /// Return the oldest element or nullptr if the queue is empty
+    T * front();
+    /// Release the element returned by front()
+    void pop();
+
+    bool empty() const { return m_producer.position.load(std::memory_order_acquire) == m_consumer.position.load(std::memory_order_acquire); }
+
+private:
+    // Each side owns a cache line holding its position and its cached copy of the other side's position
+    struct side
+    {
+        std::atomic<std::uint64_t> position;
+        std::uint64_t other_position;
+        char padding[64 - sizeof(std::atomic<std::uint64_t>) - sizeof(std::uint64_t)];
+    };
+
+    const std::uint64_t m_mask;
+    std::vector<T> m_slots;
+
+    side m_producer;
+    side m_consumer;
+};
+
+template <typename T>
+spsc_queue<T>::spsc_queue(std::size_t capacity)
+    : m_mask((capacity && !(capacity & (capacity - 1))) ? capacity - 1 : throw std::invalid_argument("spsc_queue: capacity must be a power of 2"))
+    , m_slots(capacity)
+{
+    m_producer.position.store(0, std::memory_order_relaxed);
+    m_producer.other_position = 0;
+    m_consumer.position.store(0, std::memory_order_relaxed);
+    m_consumer.other_position = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename T>
+BOOST_FORCEINLINE bool spsc_queue<T>::try_push(T && value)
+{
+    const auto position = m_producer.position.load(std::memory_order_relaxed);
+    if(BOOST_UNLIKELY(position - m_producer.other_position > m_mask))
+    {
+        m_producer.other_position = m_consumer.position.load(std::memory_order_acquire);
+        if(position - m_producer.other_position > m_mask)
+            return false;
+    }
+    m_slots[position & m_mask] = std::move(value);
+    m_producer.position.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+BOOST_FORCEINLINE T * spsc_queue<T>::front()
+{
+    const auto position = m_consumer.position.load(std::memory_order_relaxed);
+    if(BOOST_UNLIKELY(position == m_consumer.other_position))
+    {
+        m_consumer.other_position = m_producer.position.load(std::memory_order_acquire);
+        if(position == m_consumer.other_position)
+            return nullptr;
+    }
+    return &m_slots[position & m_mask];
+}
+
+template <typename T>
+BOOST_FORCEINLINE void spsc_queue<T>::pop()
+{
+    const auto position = m_consumer.position.load(std::memory_order_relaxed);
+    m_consumer.position.store(position + 1, std::memory_order_release);
+}
+
+}
+}
@@ -20,9 +20,11 @@ limitations under the License.
 #include "math_util.h"
 
 #include <linux/unistd.h>
+#include <signal.h>
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <fstream>
 #include <stdexcept>
 #include <string>
@@ -38,6 +40,26 @@ std::int32_t get_native_thread_id()
     return tid;
 }
 
+std::int32_t native_thread_id_limit()
+{
+    static const std::int32_t limit = []()
+    {
+        std::ifstream is("/proc/sys/kernel/pid_max");
+        if(!is)
+            throw std::runtime_error("Cannot access /proc/sys/kernel/pid_max");
+        std::int32_t v;
+        is >> v;
+        return v;
+    }();
+    return limit;
+}
+
+bool process_alive(std::int32_t pid)
+{
+    // Signal 0 only checks whether the process exists (EPERM - it does, but belongs to somebody else)
+    return ::kill(pid, 0) == 0 || errno == EPERM;
+}
+
 std::int32_t thread_id_bits()
 {
     std::ifstream is("/proc/sys/kernel/threads-max");
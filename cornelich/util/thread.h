@@ -27,6 +27,12 @@ namespace util
 /** Return the native (operating system) thread id of the current thread */
 std::int32_t get_native_thread_id();
 
+/** Return the limit of the native thread ids (pid_max) - all of them are below it */
+std::int32_t native_thread_id_limit();
+
+/** Return whether the process with the given id is running */
+bool process_alive(std::int32_t pid);
+
 /** Return how many bits are being used to represent a thread identifier */
 std::int32_t thread_id_bits();
 
@@ -18,12 +18,47 @@ limitations under the License.
 #include "vanilla_chronicle.h"
 
 #include "util/math_util.h"
+#include "util/thread.h"
+#include "util/streamer.h"
+
+#include <boost/filesystem.hpp>
 
 #include <cmath>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
 
 namespace cornelich
 {
 
+namespace
+{
+
+/// The last written index of a chronicle path - one per process, alive while a vanilla_chronicle uses it
+std::shared_ptr<std::atomic<std::int64_t>> shared_last_written_index(const std::string & path)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::weak_ptr<std::atomic<std::int64_t>>> watermarks;
+
+    const auto key = boost::filesystem::weakly_canonical(boost::filesystem::absolute(path)).string();
+    std::lock_guard<std::mutex> lk(lock);
+    auto & watermark = watermarks[key];
+    auto result = watermark.lock();
+    if(!result)
+    {
+        result = std::make_shared<std::atomic<std::int64_t>>(-1);
+        watermark = result;
+    }
+    // Forget the paths nobody uses any more
+    for(auto it = watermarks.begin(); it != watermarks.end();)
+        it = it->second.expired() ? watermarks.erase(it) : std::next(it);
+    return result;
+}
+
+}
+
 vanilla_chronicle::vanilla_chronicle(const vanilla_chronicle_settings & settings)
     : m_settings(settings)
     , m_index_block_size_bits( (std::int32_t)std::log2(m_settings.index_block_size()) )
@@ -34,14 +69,24 @@ vanilla_chronicle::vanilla_chronicle(const vanilla_chronicle_settings & settings
     , m_data_block_size_mask( ((std::int64_t)1 << m_data_block_size_bits) - 1 )
     , m_entries_for_cycle_bits( (std::int32_t)std::log2(m_settings.entries_per_cycle()) )
     , m_entries_for_cycle_mask( ((std::int64_t)1 << m_entries_for_cycle_bits) - 1 )
-    , m_index(m_settings, m_index_block_size_bits)
-    , m_data(m_settings, m_data_block_size_bits)
-    , m_last_written_index(-1)
+    , m_directory(m_settings)
+    , m_index(m_settings, m_directory, m_index_block_size_bits)
+    , m_data(m_settings, m_directory, m_data_block_size_bits)
+    , m_time_index(m_settings, m_index_block_longs_bits)
+    , m_header(m_settings.shared_header() ? new vanilla_header(m_settings) : nullptr)
+    , m_last_written_index(shared_last_written_index(m_settings.path()))
 {
 }
 
 std::int64_t vanilla_chronicle::last_index()
 {
+    if(m_header)
+    {
+        const auto last = m_header->last_index();
+        if(last >= 0)
+            return last;
+    }
+
     const auto last_cycle = m_index.find_last_cycle();
     if(last_cycle == -1)
         return -1;
@@ -53,19 +98,68 @@ std::int64_t vanilla_chronicle::last_index()
     const auto region = m_index.index_for(last_cycle, last_file, false);
     if(!region)
         return -1;
-    const auto count_entries = vanilla_index::count_index_entries(*region);
-    const auto index_entry_number = (count_entries > 0) ? count_entries - 1 : 0;
+    const auto last_entry = vanilla_index::find_last_entry(*region);
+    const auto index_entry_number = (last_entry > 0) ? last_entry : 0;
 
     return (static_cast<std::int64_t>(last_cycle) <<  m_entries_for_cycle_bits) +
-           (static_cast<std::int64_t>(last_file) << m_index_block_size_bits) +
+           (static_cast<std::int64_t>(last_file) << m_index_block_longs_bits) +
            index_entry_number;
 }
 
+std::int64_t vanilla_chronicle::excerpts_between(std::int64_t from, std::int64_t to)
+{
+    const auto from_cycle = static_cast<std::int32_t>(util::right_shift(from, m_entries_for_cycle_bits));
+    const auto to_cycle = static_cast<std::int32_t>(util::right_shift(to, m_entries_for_cycle_bits));
+    if(from_cycle == to_cycle)
+        return to - from;
+
+    // The rest of the first cycle, the cycles in between and the beginning of the last one
+    const auto first_last = last_index_in_cycle(from_cycle);
+    auto count = first_last >= from ? first_last - from : 0;
+    for(auto cycle = m_directory.next_cycle(from_cycle); cycle >= 0 && cycle < to_cycle; cycle = m_directory.next_cycle(cycle))
+    {
+        const auto last = last_index_in_cycle(cycle);
+        if(last >= 0)
+            count += (last & m_entries_for_cycle_mask) + 1;
+    }
+    return count + (to & m_entries_for_cycle_mask) + 1;
+}
+
+std::int64_t vanilla_chronicle::last_index_in_cycle(std::int32_t cycle)
+{
+    const auto last_file = m_index.last_index_file_number(cycle, -1);
+    if(last_file < 0)
+        return -1;
+    const auto region = m_index.index_for(cycle, last_file, false);
+    const auto last_entry = region ? vanilla_index::find_last_entry(*region) : -1;
+    const auto cycle_start = static_cast<std::int64_t>(cycle) << m_entries_for_cycle_bits;
+    if(last_entry >= 0)
+        return cycle_start + (static_cast<std::int64_t>(last_file) << m_index_block_longs_bits) + last_entry;
+    // The last index file is still empty - the previous ones are full
+    return last_file > 0 ? cycle_start + (static_cast<std::int64_t>(last_file) << m_index_block_longs_bits) - 1 : -1;
+}
+
+checkpoint_store & vanilla_chronicle::checkpoints()
+{
+    std::call_once(m_checkpoints_created, [this]() { m_checkpoints.reset(new checkpoint_store(m_settings.path())); });
+    return *m_checkpoints;
+}
+
 excerpt_appender vanilla_chronicle::create_appender()
 {
     return excerpt_appender(*this);
 }
 
+excerpt_appender vanilla_chronicle::create_appender(std::int32_t writer_id)
+{
+    return excerpt_appender(*this, writer_id);
+}
+
+std::int32_t vanilla_chronicle::first_writer_id() const
+{
+    return util::native_thread_id_limit();
+}
+
 excerpt_tailer vanilla_chronicle::create_tailer()
 {
     return excerpt_tailer(*this);
@@ -18,6 +18,10 @@ limitations under the License.
 #pragma once
 
 #include "vanilla_chronicle_settings.h"
+#include "checkpoint_store.h"
+#include "vanilla_directory.h"
+#include "vanilla_header.h"
+#include "vanilla_time_index.h"
 #include "vanilla_index.h"
 #include "vanilla_data.h"
 #include "excerpt_appender.h"
@@ -26,6 +30,8 @@ limitations under the License.
 #include <atomic>
 #include <cstdint>
 #include <iosfwd>
+#include <memory>
+#include <mutex>
 
 namespace cornelich
 {
@@ -35,6 +41,8 @@ class vanilla_chronicle
 public:
     explicit vanilla_chronicle(const vanilla_chronicle_settings & settings);
 
+    const vanilla_chronicle_settings & settings() const { return m_settings; }
+
     std::int64_t index_block_size_mask() const { return m_index_block_size_mask; }
     std::int64_t index_block_longs_mask() const { return m_index_block_longs_mask; }
     std::int64_t data_block_size_mask() const { return m_data_block_size_mask; }
@@ -45,13 +53,37 @@ public:
       * @return The last index in the file
       */
     std::int64_t last_index();
-    std::int64_t last_written_index() const { return m_last_written_index; }
+    /// The last index written in this process - through any vanilla_chronicle opened at the same path
+    std::int64_t last_written_index() const { return m_last_written_index->load(std::memory_order_acquire); }
+
+    /// Number of excerpts after the index from up to and including the index to (from <= to), across the cycles
+    std::int64_t excerpts_between(std::int64_t from, std::int64_t to);
 
     excerpt_appender create_appender();
+    /// Create an appender writing with a fixed writer id (see excerpt_appender)
+    excerpt_appender create_appender(std::int32_t writer_id);
+
+    /**
+     * The lowest fixed writer id - the native thread ids (used by the appenders without a writer id)
+     * are all below it (pid_max). The fixed ids go from here up to thread_id_mask(), so the thread_id_bits
+     * of the settings have to leave room for them.
+     */
+    std::int32_t first_writer_id() const;
+
     excerpt_tailer create_tailer();
+
+    /// The named consumer positions of the chronicle (the file gets created on the first use)
+    checkpoint_store & checkpoints();
+
+    /// The shared header (nullptr unless vanilla_chronicle_settings::shared_header is on)
+    vanilla_header * header() { return m_header.get(); }
 private:
+    /// The last index of a cycle (-1 if it has no excerpts)
+    std::int64_t last_index_in_cycle(std::int32_t cycle);
+
     friend class excerpt_appender;
     friend class excerpt_tailer;
+    friend class replay_engine;
 
     const vanilla_chronicle_settings m_settings;
     const std::int32_t m_index_block_size_bits;
@@ -66,10 +98,17 @@ private:
     const std::int32_t m_entries_for_cycle_bits;
     const std::int64_t m_entries_for_cycle_mask;
 
+    vanilla_directory m_directory;
     vanilla_index m_index;
     vanilla_data m_data;
+    vanilla_time_index m_time_index;
+    const std::unique_ptr<vanilla_header> m_header;
+
+    std::once_flag m_checkpoints_created;
+    std::unique_ptr<checkpoint_store> m_checkpoints;
 
-    std::atomic_int_fast64_t m_last_written_index;
+    /// Shared by all the vanilla_chronicle objects of the process opened at the same path
+    const std::shared_ptr<std::atomic<std::int64_t>> m_last_written_index;
 };
 
 }
@@ -38,6 +38,8 @@ vanilla_chronicle_settings::vanilla_chronicle_settings(const std::string & path)
     , m_data_block_size(64ULL << 20) // 64MB
     , m_index_cache_size(8)
     , m_data_cache_size(16)
+    , m_time_index_interval(0)
+    , m_shared_header(false)
 {
 }
 
@@ -53,6 +55,7 @@ vanilla_chronicle_settings & vanilla_chronicle_settings::cycle_length(const std:
 std::ostream & operator<<(std::ostream & os, const vanilla_chronicle_settings & s)
 {
     os << "- path                   = " << s.path() << '\n'
+       << "- active_path            = " << s.active_path() << '\n'
        << "- cycle_length           = " << s.cycle_length() << '\n'
        << "- entries_per_cycle      = " << s.entries_per_cycle() << " [" << std::log2(s.entries_per_cycle()) << " bits]\n"
        << "- index_block_size       = " << s.index_block_size() << " [" << std::log2(s.index_block_size()) << " bits]\n"
@@ -60,9 +63,11 @@ std::ostream & operator<<(std::ostream & os, const vanilla_chronicle_settings &
        << "- thread_id_bits         = " << s.thread_id_bits() << '\n'
        << "- thread_id_mask         = 0x" << std::hex << s.thread_id_mask() << std::dec << '\n'
        << "- index_data_offset_bits = " << s.index_data_offset_bits() << '\n'
-       << "- index_data_offset_mask = 0x" << std::hex << s.index_data_offset_mask() << std::dec
+       << "- index_data_offset_mask = 0x" << std::hex << s.index_data_offset_mask() << std::dec << '\n'
        << "- index_cache_size       = " << s.index_cache_size() << '\n'
-       << "- data_cache_size        = " << s.data_cache_size();
+       << "- data_cache_size        = " << s.data_cache_size() << '\n'
+       << "- time_index_interval    = " << s.time_index_interval() << '\n'
+       << "- shared_header          = " << std::boolalpha << s.shared_header() << std::noboolalpha;
     return os;
 }
 
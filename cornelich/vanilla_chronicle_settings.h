@@ -29,6 +29,12 @@ class cycle_formatter;
 static constexpr std::int64_t min_cycle_length() { return 60 * 60 * 1000; }
 static const std::string INDEX_FILE_NAME_PREFIX = "index-";
 static const std::string DATA_FILE_NAME_PREFIX = "data-";
+static const std::string TIME_FILE_NAME_PREFIX = "time-";
+static const std::string CONSUMER_FILE_NAME_PREFIX = "consumer-";
+static const std::string CHECKPOINT_FILE_NAME = "checkpoints";
+static const std::string CHECKPOINT_LOCK_FILE_SUFFIX = ".lock";
+static const std::string HEADER_FILE_NAME = "header";
+static const std::string WRITER_LOCK_FILE_NAME_PREFIX = "writer-";
 static constexpr std::int32_t DEFAULT_THREAD_ID_BITS = 16;
 
 class vanilla_chronicle_settings
@@ -40,6 +46,15 @@ public:
     /// Return chronicle base path
     const std::string & path() const { return m_path; }
 
+    /**
+     * Path of the active tier (e.g. on tmpfs) - empty if the chronicle is kept in one place (the default).
+     * With the active tier the new cycle files are created there and moved to the base path once
+     * the cycle is closed (see tier_mover); the files are looked up in both places.
+     */
+    const std::string & active_path() const { return m_active_path; }
+    /// Set the path of the active tier (all the processes using the chronicle must agree)
+    vanilla_chronicle_settings & active_path(const std::string & path) { m_active_path = path; return *this; }
+
     /// Length of a cycle in milliseconds
     std::int32_t cycle_length() const { return m_cycle_length; }
     /// Set the length of a cycle in milliseconds. By default check for sane values of the parameter.
@@ -65,7 +80,11 @@ public:
 
     /// Number of bits used for storing the thread id in this chronicle
     std::int32_t thread_id_bits() const { return m_thread_id_bits; }
-    /// Set the number of bits to use for storing the thread id
+    /**
+     * Set the number of bits to use for storing the thread id. The fixed writer ids (see
+     * vanilla_chronicle::first_writer_id() and appender_pool) start above the native thread ids at pid_max,
+     * so with the default bits they fit only where pid_max < 65536 - the systemd default of 4194304 needs 23.
+     */
     vanilla_chronicle_settings & thread_id_bits(std::int32_t thread_id_bits) { m_thread_id_bits = thread_id_bits; return *this;}
 
     /// Mask used to validate that the thread id does not exceed the allocated number of bits.
@@ -77,6 +96,16 @@ public:
     /// Mask used to extract the data offset info from an index entry.
     std::int64_t index_data_offset_mask() const { return (INT64_C(1) << index_data_offset_bits()) - 1; }
 
+    /// Every how many index entries the appenders record the time (in the time-N file next to index-N); 0 - never
+    std::int32_t time_index_interval() const { return m_time_index_interval; }
+    /// Set every how many index entries the time gets recorded (must be a power of 2 or 0 to disable it)
+    vanilla_chronicle_settings & time_index_interval(std::int32_t interval) { m_time_index_interval = interval; return *this; }
+
+    /// Whether the appenders publish the last committed index in the shared header file (see vanilla_header)
+    bool shared_header() const { return m_shared_header; }
+    /// Turn the shared header on or off (all the processes writing the chronicle must agree)
+    vanilla_chronicle_settings & shared_header(bool shared) { m_shared_header = shared; return *this; }
+
     std::size_t index_cache_size() const { return m_index_cache_size; }
     vanilla_chronicle_settings & index_cache_size(std::size_t size) { m_index_cache_size = size; return *this; }
 
@@ -86,6 +115,7 @@ private:
     friend std::ostream & operator<<(std::ostream &os, const vanilla_chronicle_settings & s);
 
     const std::string m_path;
+    std::string m_active_path;
     std::int32_t m_thread_id_bits;
     std::int32_t m_cycle_length;
     std::shared_ptr<cycle_formatter> m_cycle_format;
@@ -94,6 +124,8 @@ private:
     std::int64_t m_data_block_size;
     std::size_t m_index_cache_size;
     std::size_t m_data_cache_size;
+    std::int32_t m_time_index_interval;
+    bool m_shared_header;
 };
 
 std::ostream & operator<<(std::ostream & os, const vanilla_chronicle_settings & s);
@@ -19,26 +19,24 @@ limitations under the License.
 
 #include "vanilla_chronicle_settings.h"
 #include "vanilla_date.h"
+#include "vanilla_directory.h"
 #include "vanilla_utils.h"
 #include "region.h"
 
-#include "util/parse.h"
+#include "util/math_util.h"
 #include "util/streamer.h"
 
-#include <boost/filesystem.hpp>
-#include <boost/range/iterator_range.hpp>
-namespace fs = boost::filesystem;
-
-#include <boost/algorithm/string.hpp>
+#include <algorithm>
 #include <memory>
-#include <limits>
 #include <mutex>
+#include <stdexcept>
 
 namespace cornelich
 {
 
-vanilla_data::vanilla_data(const vanilla_chronicle_settings & settings, std::int32_t data_block_size_bits)
+vanilla_data::vanilla_data(const vanilla_chronicle_settings & settings, vanilla_directory & directory, std::int32_t data_block_size_bits)
     : m_settings(settings)
+    , m_directory(directory)
     , m_data_block_size_bits(data_block_size_bits)
     , m_cache(settings.data_cache_size(), region_ptr_validator())
 {
@@ -46,29 +44,61 @@ vanilla_data::vanilla_data(const vanilla_chronicle_settings & settings, std::int
 
 std::int32_t vanilla_data::find_next_data_file_number(std::int32_t cycle, std::int32_t thread_id) const
 {
-    std::int32_t last_number = -1;
-    const auto path = fs::path(m_settings.path()) / m_settings.cycle_format().date_from_cycle(cycle);
-
-    boost::system::error_code err;
-    fs::directory_iterator begin(path, err);
-    fs::directory_iterator end;
+    // Move to the next data file
+    return find_last_data_file_number(cycle, thread_id) + 1;
+}
 
-    const auto data_prefix = (util::streamer() << DATA_FILE_NAME_PREFIX << thread_id << '-').str();
+std::int32_t vanilla_data::find_last_data_file_number(std::int32_t cycle, std::int32_t thread_id) const
+{
+    return m_directory.last_data_file_number(cycle, thread_id);
+}
 
-    for(const auto & entry : boost::make_iterator_range(begin, end))
+vanilla_data::append_lease_ptr vanilla_data::data_for_append(std::int32_t cycle, std::int32_t thread_id, bool resume)
+{
+    const auto last_number = find_last_data_file_number(cycle, thread_id);
+    auto key = std::make_tuple(cycle, thread_id, last_number < 0 ? 0 : last_number);
+    auto resumed = false;
+    auto position = 0;
     {
-        auto name = entry.path().filename().native();
-        if(boost::algorithm::starts_with(name, data_prefix))
+        std::lock_guard<mutex_t> lk(m_append_lock);
+        if(last_number >= 0 && (!resume || m_leased.count(key)))
+            ++std::get<2>(key);
+        // Another appender of the thread might have just started the next file
+        while(m_leased.count(key))
+            ++std::get<2>(key);
+        m_leased.insert(key);
+
+        resumed = std::get<2>(key) == last_number;
+        auto released = m_released_positions.find(key);
+        if(released != m_released_positions.end())
         {
-            std::int32_t index = -1;
-            util::parse_number(name.begin() + (std::int32_t)data_prefix.size(), name.end(), index);
-            if(last_number < index)
-                last_number = index;
+            position = released->second;
+            m_released_positions.erase(released);
         }
     }
-    // Move to the next data file
-    return last_number + 1;
 
+    auto region = data_for(cycle, thread_id, std::get<2>(key), true);
+    if(resumed)
+    {
+        // Continue after the last committed excerpt
+        position = find_data_end(*region, position);
+    }
+    return append_lease_ptr(new append_lease(*this, key, std::move(region), position));
+}
+
+vanilla_data::append_lease::append_lease(vanilla_data & data, const key_t & key, region_ptr region, std::int32_t position)
+    : m_data(data)
+    , m_key(key)
+    , m_region(std::move(region))
+    , m_position(position)
+{
+}
+
+vanilla_data::append_lease::~append_lease()
+{
+    std::lock_guard<mutex_t> lk(m_data.m_append_lock);
+    m_data.m_leased.erase(m_key);
+    m_data.m_released_positions[m_key] = m_position;
 }
 
 region_ptr vanilla_data::data_for(std::int32_t cycle, std::int32_t thread_id, std::int32_t file_number, bool for_write)
@@ -80,10 +110,12 @@ region_ptr vanilla_data::data_for(std::int32_t cycle, std::int32_t thread_id, st
         auto cycle_ = std::get<0>(k);
         auto thread_id_ = std::get<1>(k);
         auto file_number_ = std::get<2>(k);
-        auto && path = make_file(m_settings.path(),
+        auto && path = make_file(m_settings,
                                  m_settings.cycle_format().date_from_cycle(cycle_),
                                  (util::streamer() << DATA_FILE_NAME_PREFIX << thread_id_ << '-' << file_number_).str(),
                                  for_write);
+        if(for_write)
+            m_directory.add_data_file(cycle_, thread_id_, file_number_);
         return !path.empty()
                 ? std::make_shared<region>(path, 1LL << m_data_block_size_bits, file_number_)
                 : region_ptr();
@@ -92,5 +124,24 @@ region_ptr vanilla_data::data_for(std::int32_t cycle, std::int32_t thread_id, st
     return m_cache.get(key, creator);
 }
 
+std::int32_t vanilla_data::find_data_end(const region & region, std::int32_t offset)
+{
+    // Each excerpt is stored as: [~length (4 bytes)][data (length bytes)][padding to 4 bytes]
+    // A zero length word marks the first unused (or not yet committed) location.
+    while(region.limit() - offset >= 4)
+    {
+        const auto len = region.read_ordered32(offset);
+        if(!len)
+            break;
+
+        const auto len2 = ~len;
+        if(util::right_shift(len2, 30))
+            throw std::logic_error(util::streamer() << "Corrupted length 0x" << std::hex << len << std::dec
+                                                    << " at " << offset << " in " << region.path());
+        offset = (offset + 4 + len2 + 3) & ~3;
+    }
+    return std::min(offset, region.limit());
+}
+
 
 }
@@ -25,6 +25,8 @@ limitations under the License.
 #include <cstdint>
 #include <memory>
 //#include <mutex>
+#include <map>
+#include <set>
 #include <tuple>
 
 namespace cornelich
@@ -34,30 +36,85 @@ class region;
 using region_ptr = std::shared_ptr<region>;
 using weak_region_ptr = std::weak_ptr<region>;
 class vanilla_chronicle_settings;
+class vanilla_directory;
 
 /// This class manages the chronicle data files (mmaped regions)
 class vanilla_data
 {
+    using key_t = std::tuple<std::int32_t, std::int32_t, std::int32_t>;
 public:
+    /**
+     * A data file reserved for one appender of this process (see data_for_append()) together with
+     * the position the appender writes at next. Released when destroyed.
+     */
+    class append_lease
+    {
+    public:
+        append_lease(vanilla_data & data, const key_t & key, region_ptr region, std::int32_t position);
+        ~append_lease();
+
+        append_lease(const append_lease &) = delete;
+        append_lease & operator=(const append_lease &) = delete;
+
+        const region_ptr & region() const { return m_region; }
+        std::int32_t file_number() const { return std::get<2>(m_key); }
+
+        /// Offset just past the last excerpt of the appender (where the next one goes)
+        std::int32_t position() const { return m_position; }
+        void position(std::int32_t position) { m_position = position; }
+
+    private:
+        vanilla_data & m_data;
+        const key_t m_key;
+        const region_ptr m_region;
+        std::int32_t m_position;
+    };
+    using append_lease_ptr = std::unique_ptr<append_lease>;
+
     /// Create a data-region manager using the given settings and desired region size
-    vanilla_data(const vanilla_chronicle_settings & settings, std::int32_t data_block_size_bits);
+    vanilla_data(const vanilla_chronicle_settings & settings, vanilla_directory & directory, std::int32_t data_block_size_bits);
 
     /// Find the next free region number for a specific (cycle / thread_id) pair
     /// If we have /tmp/chron/20151114/data-9791-0 and we want a next number for a cycle corresponding
     /// to 2015114 and thread 9791 we shall get 1
     std::int32_t find_next_data_file_number(std::int32_t cycle, std::int32_t thread_id) const;
 
+    /// Find the last existing region number for a specific (cycle / thread_id) pair
+    /// Return -1 if there is no data file for that pair yet
+    std::int32_t find_last_data_file_number(std::int32_t cycle, std::int32_t thread_id) const;
+
+    /**
+     * Reserve the data file an appender writes into for a specific (cycle / thread_id) pair.
+     * This is the last existing data file (the lease is positioned just after its last committed excerpt)
+     * unless resume is false or another appender of this process holds it - a new one otherwise.
+     * The file stays reserved until the lease is destroyed.
+     *
+     * Only the appenders of this process are known here: the thread id (a writer id, see
+     * excerpt_appender) must not be used by two processes at once.
+     */
+    append_lease_ptr data_for_append(std::int32_t cycle, std::int32_t thread_id, bool resume);
+
     /// Return a pointer to a specific (cycle, thread_id, file_number) region
     /// If there is no such region AND we set for_write to false an empty pointer shall be returned.
     region_ptr data_for(std::int32_t cycle, std::int32_t thread_id, std::int32_t file_number, bool for_write);
 
+    /// Return the offset just past the last committed excerpt in the region.
+    /// The length words are followed starting at the given offset until an empty one is found.
+    static std::int32_t find_data_end(const region & region, std::int32_t offset);
+
 private:
     const vanilla_chronicle_settings & m_settings;
+    vanilla_directory & m_directory;
     const std::int32_t m_data_block_size_bits;
     using mutex_t = util::spin_lock;
     mutex_t m_lock;
-    using key_t = std::tuple<std::int32_t, std::int32_t, std::int32_t>;
     util::cache<key_t, region_ptr, region_ptr_validator> m_cache;
+
+    mutex_t m_append_lock;
+    /// The files leased to the appenders
+    std::set<key_t> m_leased;
+    /// Where the last appender of a file stopped - so the next one does not look for the end from the start
+    std::map<key_t, std::int32_t> m_released_positions;
 };
 
 }
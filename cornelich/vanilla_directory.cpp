@@ -0,0 +1,418 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "vanilla_directory.h"
+
+#include "vanilla_chronicle_settings.h"
+#include "vanilla_date.h"
+#include "vanilla_utils.h"
+
+#include "util/parse.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/range/iterator_range.hpp>
+namespace fs = boost::filesystem;
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <mutex>
+
+namespace cornelich
+{
+
+namespace
+{
+
+constexpr std::uint32_t BASE_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+constexpr std::uint32_t CYCLE_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+}
+
+constexpr std::size_t vanilla_directory::MAX_TIERS;
+
+vanilla_directory::vanilla_directory(const vanilla_chronicle_settings & settings)
+    : m_settings(settings)
+    , m_cycles_valid(false)
+    , m_inotify_fd(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , m_scanned(false)
+{
+    if(!settings.active_path().empty())
+    {
+        m_tiers.push_back(settings.active_path());
+        // Both tiers have to be watched - a missing one would turn the lookups into scans until the first move
+        boost::system::error_code err;
+        fs::create_directories(settings.active_path(), err);
+        fs::create_directories(settings.path(), err);
+    }
+    m_tiers.push_back(settings.path());
+    m_base_watches.assign(m_tiers.size(), -1);
+    m_states.resize(m_tiers.size());
+}
+
+vanilla_directory::~vanilla_directory()
+{
+    if(m_inotify_fd >= 0)
+        ::close(m_inotify_fd);
+}
+
+std::int32_t vanilla_directory::first_cycle()
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    return m_cycles.empty() ? -1 : m_cycles.begin()->first;
+}
+
+std::int32_t vanilla_directory::last_cycle()
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    return m_cycles.empty() ? -1 : m_cycles.rbegin()->first;
+}
+
+std::int32_t vanilla_directory::next_cycle(std::int32_t cycle)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    // Nobody creates cycles from the future - no need to look at the directory when already there
+    if(!(m_scanned && cycle >= cycle_for_now(m_settings.cycle_length())))
+    {
+        // Other processes may have created cycles (including ones before the cycles known so far)
+        refresh();
+    }
+    auto it = m_cycles.upper_bound(cycle);
+    return it != m_cycles.end() ? it->first : -1;
+}
+
+std::int32_t vanilla_directory::prev_cycle(std::int32_t cycle)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    auto it = m_cycles.lower_bound(cycle);
+    return it != m_cycles.begin() ? std::prev(it)->first : -1;
+}
+
+std::vector<std::int32_t> vanilla_directory::cycles()
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    std::vector<std::int32_t> result;
+    result.reserve(m_cycles.size());
+    for(auto && cycle : m_cycles)
+        result.push_back(cycle.first);
+    return result;
+}
+
+std::int32_t vanilla_directory::last_index_file_number(std::int32_t cycle)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    auto entry = scanned_cycle(cycle);
+    return entry ? entry->last_index_file_number : -1;
+}
+
+std::int32_t vanilla_directory::last_data_file_number(std::int32_t cycle, std::int32_t thread_id)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    refresh();
+    auto entry = scanned_cycle(cycle);
+    if(!entry)
+        return -1;
+    auto it = entry->last_data_file_numbers.find(thread_id);
+    return it != entry->last_data_file_numbers.end() ? it->second : -1;
+}
+
+void vanilla_directory::add_cycle(std::int32_t cycle)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    m_cycles[cycle];
+}
+
+void vanilla_directory::add_index_file(std::int32_t cycle, std::int32_t file_number)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    auto & entry = m_cycles[cycle];
+    if(entry.scanned)
+        entry.last_index_file_number = std::max(entry.last_index_file_number, file_number);
+}
+
+void vanilla_directory::add_data_file(std::int32_t cycle, std::int32_t thread_id, std::int32_t file_number)
+{
+    std::lock_guard<mutex_t> lk(m_lock);
+    auto & entry = m_cycles[cycle];
+    if(entry.scanned)
+    {
+        auto & last = entry.last_data_file_numbers.emplace(thread_id, -1).first->second;
+        last = std::max(last, file_number);
+    }
+}
+
+void vanilla_directory::refresh()
+{
+    if(m_inotify_fd >= 0)
+    {
+        auto watched = true;
+        for(std::size_t tier = 0; tier != m_tiers.size(); ++tier)
+        {
+            if(m_base_watches[tier] < 0)
+            {
+                // The chronicle directory might not exist yet - the watch has to be in place before the scan
+                m_base_watches[tier] = ::inotify_add_watch(m_inotify_fd, m_tiers[tier].c_str(), BASE_EVENTS);
+                m_cycles_valid = false;
+            }
+            watched = watched && m_base_watches[tier] >= 0;
+        }
+        if(watched)
+        {
+            drain_events();
+            if(!m_cycles_valid)
+                scan_cycles();
+            m_scanned = true;
+            return;
+        }
+    }
+
+    auto changed = !m_scanned;
+    auto exists = false;
+    for(std::size_t tier = 0; tier != m_tiers.size(); ++tier)
+    {
+        directory_state state;
+        struct stat st;
+        if(::stat(m_tiers[tier].c_str(), &st) == 0)
+        {
+            state.exists = true;
+            state.mtime_sec = st.st_mtim.tv_sec;
+            state.mtime_nsec = st.st_mtim.tv_nsec;
+            state.link_count = st.st_nlink;
+        }
+        exists = exists || state.exists;
+        // Changes during the scan will change the directory again - so the next refresh catches them
+        changed = changed || !(state == m_states[tier]);
+        m_states[tier] = state;
+    }
+    m_scanned = true;
+    if(!exists)
+        m_cycles.clear();
+    else if(changed)
+        scan_cycles();
+}
+
+void vanilla_directory::drain_events()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    while(true)
+    {
+        const auto length = ::read(m_inotify_fd, buffer, sizeof(buffer));
+        if(length <= 0)
+            return;
+
+        for(auto * p = buffer; p < buffer + length; )
+        {
+            const auto * event = reinterpret_cast<const struct inotify_event *>(p);
+            p += sizeof(struct inotify_event) + event->len;
+
+            if(event->mask & IN_Q_OVERFLOW)
+            {
+                // Lost events - start over
+                m_cycles_valid = false;
+                for(auto && cycle : m_cycles)
+                    cycle.second.scanned = false;
+                continue;
+            }
+
+            const auto base = std::find(m_base_watches.begin(), m_base_watches.end(), event->wd);
+            if(base != m_base_watches.end())
+            {
+                if(event->mask & IN_IGNORED)
+                {
+                    // The chronicle directory is gone
+                    *base = -1;
+                    m_cycles_valid = false;
+                    continue;
+                }
+                if(!event->len || !(event->mask & IN_ISDIR))
+                    continue;
+                const auto cycle = m_settings.cycle_format().cycle_from_date(event->name);
+                if(cycle < 0)
+                    continue;
+                if(event->mask & (IN_CREATE | IN_MOVED_TO))
+                {
+                    // The cycle might be known from the other tier - its new directory has to be looked at
+                    m_cycles[cycle].scanned = false;
+                }
+                else if(m_tiers.size() == 1)
+                {
+                    auto it = m_cycles.find(cycle);
+                    if(it != m_cycles.end())
+                    {
+                        unwatch(it->second);
+                        m_cycles.erase(it);
+                    }
+                }
+                else
+                {
+                    // The cycle might still be in the other tier
+                    m_cycles_valid = false;
+                }
+                continue;
+            }
+
+            auto watched = m_watched_cycles.find(event->wd);
+            if(watched == m_watched_cycles.end())
+                continue;
+            auto it = m_cycles.find(watched->second);
+            if(it == m_cycles.end())
+            {
+                m_watched_cycles.erase(watched);
+                continue;
+            }
+            auto & entry = it->second;
+            if(event->mask & IN_IGNORED)
+            {
+                m_watched_cycles.erase(watched);
+                std::replace(std::begin(entry.watches), std::end(entry.watches), event->wd, -1);
+                entry.scanned = false;
+            }
+            else if(event->len && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+            {
+                if(entry.scanned)
+                    add_file(entry, event->name);
+            }
+            else if(event->mask & (IN_DELETE | IN_MOVED_FROM))
+            {
+                // The last file numbers might have gone down - look at the directory again
+                entry.scanned = false;
+            }
+        }
+    }
+}
+
+void vanilla_directory::scan_cycles()
+{
+    std::map<std::int32_t, cycle_entry> cycles;
+    for(auto && tier : m_tiers)
+    {
+        boost::system::error_code err;
+        fs::directory_iterator begin(tier, err);
+        fs::directory_iterator end;
+        for(const auto & entry : boost::make_iterator_range(begin, end))
+        {
+            if(!fs::is_directory(entry))
+                continue;
+            const auto cycle = m_settings.cycle_format().cycle_from_date(entry.path().filename().string());
+            if(cycle < 0 || cycles.count(cycle))
+                continue;
+            // Keep what is known about the cycles that are still there
+            auto it = m_cycles.find(cycle);
+            if(it != m_cycles.end())
+            {
+                cycles.emplace(cycle, std::move(it->second));
+                m_cycles.erase(it);
+            }
+            else
+            {
+                cycles[cycle];
+            }
+        }
+    }
+    for(auto && gone : m_cycles)
+        unwatch(gone.second);
+    m_cycles.swap(cycles);
+    m_cycles_valid = true;
+}
+
+vanilla_directory::cycle_entry * vanilla_directory::scanned_cycle(std::int32_t cycle)
+{
+    auto it = m_cycles.find(cycle);
+    if(it == m_cycles.end())
+        return nullptr;
+    auto & entry = it->second;
+    if(entry.scanned)
+        return &entry;
+
+    entry.last_index_file_number = -1;
+    entry.last_data_file_numbers.clear();
+    // Without a watch the numbers cannot be kept up to date
+    auto watched = m_inotify_fd >= 0;
+    for(std::size_t tier = 0; tier != m_tiers.size(); ++tier)
+    {
+        const auto path = fs::path(m_tiers[tier]) / m_settings.cycle_format().date_from_cycle(cycle);
+        auto & watch = entry.watches[tier];
+        if(m_inotify_fd >= 0 && watch < 0)
+        {
+            // The watch has to be in place before the scan so that no file gets missed
+            watch = ::inotify_add_watch(m_inotify_fd, path.c_str(), CYCLE_EVENTS);
+            if(watch >= 0)
+                m_watched_cycles[watch] = cycle;
+            // A cycle directory missing from one of the tiers is fine as long as its creation gets reported
+            else if(errno != ENOENT || m_tiers.size() == 1 || m_base_watches[tier] < 0)
+                watched = false;
+        }
+
+        boost::system::error_code err;
+        fs::directory_iterator begin(path, err);
+        fs::directory_iterator end;
+        for(const auto & file : boost::make_iterator_range(begin, end))
+            add_file(entry, file.path().filename().native());
+    }
+
+    entry.scanned = watched;
+    return &entry;
+}
+
+void vanilla_directory::add_file(cycle_entry & entry, const std::string & name)
+{
+    std::int32_t number = -1;
+    if(boost::algorithm::starts_with(name, INDEX_FILE_NAME_PREFIX))
+    {
+        if(util::parse_number(name.begin() + static_cast<std::string::difference_type>(INDEX_FILE_NAME_PREFIX.size()), name.end(), number))
+            entry.last_index_file_number = std::max(entry.last_index_file_number, number);
+    }
+    else if(boost::algorithm::starts_with(name, DATA_FILE_NAME_PREFIX))
+    {
+        // data-<thread id>-<file number>
+        const auto thread_begin = name.begin() + static_cast<std::string::difference_type>(DATA_FILE_NAME_PREFIX.size());
+        const auto separator = std::find(thread_begin, name.end(), '-');
+        std::int32_t thread_id = -1;
+        if(separator == name.end()
+           || !util::parse_number(thread_begin, separator, thread_id)
+           || !util::parse_number(separator + 1, name.end(), number))
+            return;
+        auto & last = entry.last_data_file_numbers.emplace(thread_id, -1).first->second;
+        last = std::max(last, number);
+    }
+}
+
+void vanilla_directory::unwatch(cycle_entry & entry)
+{
+    for(auto & watch : entry.watches)
+    {
+        if(watch >= 0)
+        {
+            ::inotify_rm_watch(m_inotify_fd, watch);
+            m_watched_cycles.erase(watch);
+            watch = -1;
+        }
+    }
+    entry.scanned = false;
+}
+
+}
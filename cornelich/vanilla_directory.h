@@ -0,0 +1,140 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "util/spin_lock.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cornelich
+{
+
+class vanilla_chronicle_settings;
+
+/**
+ * This class caches the layout of a chronicle directory: the existing cycles and,
+ * for the cycles looked at so far, their last index file and last data file of each thread.
+ *
+ * The cache is kept fresh by inotify (the chronicle directory and each cycle directory looked at get watched)
+ * and by the notifications about the files created by this process. Pending inotify events are drained
+ * without blocking on each lookup. Where inotify is not available the cycles are rescanned when the chronicle
+ * directory has changed (stat) and the files of a cycle are scanned on each lookup.
+ *
+ * With an active tier (see vanilla_chronicle_settings::active_path()) the chronicle directory of each tier
+ * is looked at and the cycles and files of both get merged.
+ */
+class vanilla_directory
+{
+public:
+    explicit vanilla_directory(const vanilla_chronicle_settings & settings);
+    ~vanilla_directory();
+
+    vanilla_directory(const vanilla_directory &) = delete;
+    vanilla_directory & operator=(const vanilla_directory &) = delete;
+
+    /// Return the first existing cycle or -1 if there is none
+    std::int32_t first_cycle();
+    /// Return the last existing cycle or -1 if there is none
+    std::int32_t last_cycle();
+    /// Return the first existing cycle after the given one or -1 if there is none
+    std::int32_t next_cycle(std::int32_t cycle);
+    /// Return the last existing cycle before the given one or -1 if there is none
+    std::int32_t prev_cycle(std::int32_t cycle);
+    /// Return all the existing cycles (sorted)
+    std::vector<std::int32_t> cycles();
+
+    /// Return the highest index file number in the cycle or -1 if there is none
+    std::int32_t last_index_file_number(std::int32_t cycle);
+    /// Return the highest data file number of the thread in the cycle or -1 if there is none
+    std::int32_t last_data_file_number(std::int32_t cycle, std::int32_t thread_id);
+
+    /// Record a cycle directory that has just been created (or is known to exist)
+    void add_cycle(std::int32_t cycle);
+    /// Record an index file that has just been created
+    void add_index_file(std::int32_t cycle, std::int32_t file_number);
+    /// Record a data file that has just been created
+    void add_data_file(std::int32_t cycle, std::int32_t thread_id, std::int32_t file_number);
+
+private:
+    /// The active tier and the base path
+    static constexpr std::size_t MAX_TIERS = 2;
+
+    struct cycle_entry
+    {
+        /// inotify watch descriptors of the cycle directory in each tier (-1 if not watched)
+        int watches[MAX_TIERS] = {-1, -1};
+        /// Whether the file numbers below are known (and kept up to date)
+        bool scanned = false;
+        std::int32_t last_index_file_number = -1;
+        /// thread id -> last data file number
+        std::unordered_map<std::int32_t, std::int32_t> last_data_file_numbers;
+    };
+
+    /// Bring the list of cycles up to date
+    void refresh();
+    /// Apply the pending inotify events
+    void drain_events();
+    /// Rebuild the list of cycles from the chronicle directory
+    void scan_cycles();
+    /// Return the entry of a cycle with its file numbers known or nullptr if there is no such cycle
+    cycle_entry * scanned_cycle(std::int32_t cycle);
+    /// Record the file name (index or data file) in the entry
+    static void add_file(cycle_entry & entry, const std::string & name);
+    void unwatch(cycle_entry & entry);
+
+    /// The state of a chronicle directory at the last scan (creating a subdirectory changes both) - without inotify
+    struct directory_state
+    {
+        bool exists = false;
+        std::time_t mtime_sec = 0;
+        long mtime_nsec = 0;
+        std::uint64_t link_count = 0;
+
+        bool operator==(const directory_state & other) const
+        {
+            return exists == other.exists && mtime_sec == other.mtime_sec
+                && mtime_nsec == other.mtime_nsec && link_count == other.link_count;
+        }
+    };
+
+    const vanilla_chronicle_settings & m_settings;
+    /// The chronicle directories - the active tier (if any) first
+    std::vector<std::string> m_tiers;
+    using mutex_t = util::spin_lock;
+    mutex_t m_lock;
+    std::map<std::int32_t, cycle_entry> m_cycles;
+    // Whether m_cycles reflects the chronicle directory (for the inotify mode)
+    bool m_cycles_valid;
+
+    int m_inotify_fd;
+    // watch descriptor of the chronicle directory of each tier
+    std::vector<int> m_base_watches;
+    // watch descriptor -> cycle
+    std::unordered_map<int, std::int32_t> m_watched_cycles;
+
+    std::vector<directory_state> m_states;
+    bool m_scanned;
+};
+
+}
@@ -0,0 +1,120 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "vanilla_header.h"
+
+#include "vanilla_chronicle_settings.h"
+
+#include "util/streamer.h"
+
+#include <boost/filesystem.hpp>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+namespace cornelich
+{
+
+namespace
+{
+
+std::string header_file(const std::string & base_path)
+{
+    boost::filesystem::create_directories(base_path);
+    return (boost::filesystem::path(base_path) / HEADER_FILE_NAME).string();
+}
+
+/// The futex word is shared between processes - so no FUTEX_PRIVATE_FLAG
+long futex(volatile std::int32_t * word, int op, std::int32_t value, const timespec * timeout)
+{
+    return ::syscall(SYS_futex, word, op, value, timeout, nullptr, 0);
+}
+
+}
+
+constexpr std::int32_t vanilla_header::SEQUENCE_OFFSET;
+constexpr std::int32_t vanilla_header::FUTEX_OFFSET;
+constexpr std::int32_t vanilla_header::WAITERS_OFFSET;
+constexpr std::int32_t vanilla_header::LAST_INDEX_OFFSET;
+constexpr std::uint32_t vanilla_header::HEADER_SIZE;
+
+vanilla_header::vanilla_header(const vanilla_chronicle_settings & settings)
+    : m_region(header_file(settings.path()), HEADER_SIZE, 0)
+{
+    {
+        // The only user - the waiters left by the readers which have died while waiting are gone too
+        const auto only_user = util::file_lock::try_lock(m_region.path());
+        if(only_user)
+            m_region.write_ordered32(WAITERS_OFFSET, 0);
+    }
+    m_user = util::file_lock::lock_shared(m_region.path());
+}
+
+void vanilla_header::committed(std::int64_t index)
+{
+    raise(LAST_INDEX_OFFSET, index + 1);
+
+    auto * data = m_region.data();
+    // Moves the futex word too. A full barrier - a reader either sees the new word or is counted in the waiters.
+    __sync_fetch_and_add(reinterpret_cast<volatile std::int64_t *>(data + SEQUENCE_OFFSET), 1);
+    if(m_region.read_ordered32(WAITERS_OFFSET) > 0)
+        futex(reinterpret_cast<volatile std::int32_t *>(data + FUTEX_OFFSET), FUTEX_WAKE, INT_MAX, nullptr);
+}
+
+bool vanilla_header::wait(std::int32_t futex_word, std::int64_t timeout) const
+{
+    timespec limit{static_cast<time_t>(timeout / 1000000), static_cast<long>(timeout % 1000000) * 1000};
+    auto * data = m_region.data();
+    auto * word = reinterpret_cast<volatile std::int32_t *>(data + FUTEX_OFFSET);
+    auto * waiters = reinterpret_cast<volatile std::int32_t *>(data + WAITERS_OFFSET);
+
+    __sync_fetch_and_add(waiters, 1);
+    const auto result = futex(word, FUTEX_WAIT, futex_word, timeout >= 0 ? &limit : nullptr);
+    const auto error = errno;
+    __sync_fetch_and_sub(waiters, 1);
+
+    if(result == 0)
+        return true;
+    switch(error)
+    {
+    case EAGAIN:    // the word has changed already
+    case EINTR:
+        return true;
+    case ETIMEDOUT:
+        return false;
+    default:
+        throw std::system_error(error, std::system_category(), "futex wait");
+    }
+}
+
+void vanilla_header::raise(std::int32_t offset, std::int64_t value)
+{
+    while(true)
+    {
+        const auto current = m_region.read_ordered64(offset);
+        if(current >= value || m_region.cas64(offset, current, value))
+            break;
+    }
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "region.h"
+#include "util/files.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace cornelich
+{
+
+class vanilla_chronicle_settings;
+
+/**
+ * The shared header of a chronicle - the memory mapped file 'header' in the chronicle base path
+ * (see vanilla_chronicle_settings::shared_header).
+ *
+ * The appenders of all the processes record every committed index in it, so a reader learns about new
+ * excerpts from a single cache line instead of the index files and the directory:
+ * - [0]  sequence        - incremented on every commit; its low 32 bits are the futex word the readers block on (see wait())
+ * - [8]  waiters         - number of readers blocked on the futex word
+ * - [16] last index + 1  - the highest committed index (0 - none)
+ *
+ * A commit costs one CAS (uncontended unless several writers commit at once) and one atomic increment,
+ * plus a futex wake while the waiters count is above 0.
+ *
+ * A reader which dies while blocked in wait() leaves the waiters count raised, so every commit pays for
+ * a futex wake until then. The count is reset when the header is opened by its only user: every
+ * vanilla_header holds a shared lock (flock) on the file, so whoever gets an exclusive one first knows
+ * that nobody can be waiting.
+ */
+class vanilla_header
+{
+public:
+    explicit vanilla_header(const vanilla_chronicle_settings & settings);
+
+    vanilla_header(const vanilla_header &) = delete;
+    vanilla_header & operator=(const vanilla_header &) = delete;
+
+    /// Record a committed index and wake up the blocked readers
+    void committed(std::int64_t index);
+
+    /// The number of commits so far
+    std::int64_t sequence() const { return m_region.read_ordered64(SEQUENCE_OFFSET); }
+    /// The current value of the futex word - to be passed to wait()
+    std::int32_t futex_word() const { return m_region.read_ordered32(FUTEX_OFFSET); }
+
+    /// Number of readers blocked in wait() - including the ones which have died there
+    std::int32_t waiters() const { return m_region.read_ordered32(WAITERS_OFFSET); }
+
+    /// The highest committed index (-1 if none)
+    std::int64_t last_index() const { return m_region.read_ordered64(LAST_INDEX_OFFSET) - 1; }
+
+    /**
+     * Block until the futex word differs from the given value (i.e. something has been committed since
+     * it was read) or timeout microseconds have passed (negative - no timeout).
+     * Return false on timeout.
+     */
+    bool wait(std::int32_t futex_word, std::int64_t timeout) const;
+
+private:
+    static constexpr std::int32_t SEQUENCE_OFFSET = 0;
+    // The low half of the sequence (little endian)
+    static constexpr std::int32_t FUTEX_OFFSET = SEQUENCE_OFFSET;
+    static constexpr std::int32_t WAITERS_OFFSET = 8;
+    static constexpr std::int32_t LAST_INDEX_OFFSET = 16;
+    static constexpr std::uint32_t HEADER_SIZE = 64;
+
+    /// Raise the 8 bytes at the offset to value unless they are higher already
+    void raise(std::int32_t offset, std::int64_t value);
+
+    mutable region m_region;
+    /// Shared by all the users of the header - see the constructor
+    std::unique_ptr<util::file_lock> m_user;
+};
+
+}
@@ -19,26 +19,21 @@ limitations under the License.
 
 #include "vanilla_chronicle_settings.h"
 #include "vanilla_date.h"
+#include "vanilla_directory.h"
 #include "vanilla_utils.h"
 #include "region.h"
 
-#include "util/parse.h"
 #include "util/streamer.h"
 
-#include <boost/filesystem.hpp>
-#include <boost/range/iterator_range.hpp>
-namespace fs = boost::filesystem;
-
-#include <boost/algorithm/string.hpp>
 #include <memory>
-#include <limits>
 #include <mutex>
 
 namespace cornelich
 {
 
-vanilla_index::vanilla_index(const vanilla_chronicle_settings & settings, std::int32_t index_block_size_bits)
+vanilla_index::vanilla_index(const vanilla_chronicle_settings & settings, vanilla_directory & directory, std::int32_t index_block_size_bits)
     : m_settings(settings)
+    , m_directory(directory)
     , m_index_block_size_bits(index_block_size_bits)
     , m_cache(settings.index_cache_size(), region_ptr_validator())
 {
@@ -46,73 +41,17 @@ vanilla_index::vanilla_index(const vanilla_chronicle_settings & settings, std::i
 
 std::int32_t vanilla_index::find_first_cycle() const
 {
-    auto first_cycle = std::numeric_limits<std::int32_t>::max();
-    boost::system::error_code err;
-    fs::directory_iterator begin(m_settings.path(), err);
-    fs::directory_iterator end;
-
-    // No directories -> empty
-    if(begin == end)
-        return -1;
-
-    // Find the earliest directory
-    for(const auto & entry : boost::make_iterator_range(begin, end))
-    {
-        if(!fs::is_directory(entry))
-            continue;
-        const auto date = m_settings.cycle_format().cycle_from_date(entry.path().filename().string());
-        if (first_cycle > date)
-            first_cycle = date;
-    }
-
-    // Did we find anything?
-    return first_cycle == std::numeric_limits<std::int32_t>::max() ? -1 : first_cycle;
+    return m_directory.first_cycle();
 }
 
 std::int32_t vanilla_index::find_last_cycle() const
 {
-    auto last_cycle = -1;
-    boost::system::error_code err;
-    fs::directory_iterator begin(m_settings.path(), err);
-    fs::directory_iterator end;
-
-    // No directories -> empty
-    if(err || begin == end)
-        return last_cycle;
-
-    // Find the newest directory
-    for(const auto & entry : boost::make_iterator_range(begin, end))
-    {
-        if(!fs::is_directory(entry))
-            continue;
-        const auto cycle = m_settings.cycle_format().cycle_from_date(entry.path().filename().string());
-        if (last_cycle < cycle)
-            last_cycle = cycle;
-    }
-    return last_cycle;
+    return m_directory.last_cycle();
 }
 
 std::int32_t vanilla_index::last_index_file_number(std::int32_t cycle, std::int32_t default_cycle) const
 {
-    std::int32_t last_number = -1;
-    const auto path = fs::path(m_settings.path()) / m_settings.cycle_format().date_from_cycle(cycle);
-
-    boost::system::error_code err;
-    fs::directory_iterator begin(path, err);
-    fs::directory_iterator end;
-
-    // Find the last index file in the specified cycle directory
-    for(const auto & entry : boost::make_iterator_range(begin, end))
-    {
-        auto name = entry.path().filename().native();
-        if(boost::algorithm::starts_with(name, INDEX_FILE_NAME_PREFIX))
-        {
-            std::int32_t index = -1;
-            util::parse_number(name.begin() + static_cast<std::string::difference_type>(INDEX_FILE_NAME_PREFIX.size()) - 1, name.end(), index);
-            if(last_number < index)
-                last_number = index;
-        }
-    }
+    const auto last_number = m_directory.last_index_file_number(cycle);
     return last_number == -1 ? default_cycle : last_number;
 }
 
@@ -128,6 +67,27 @@ std::int64_t vanilla_index::count_index_entries(const region & region)
     return indices;
 }
 
+std::int64_t vanilla_index::find_last_entry(const region & region)
+{
+    std::int64_t lo = 0;
+    std::int64_t hi = (region.size() >> 3) - 1;
+    std::int64_t found = -1;
+    while(lo <= hi)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        if(region.read_ordered64(static_cast<std::int32_t>(mid << 3)))
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
 std::pair<region_ptr, std::int64_t> vanilla_index::append(std::int32_t cycle, std::int64_t index_value, std::int32_t file_number)
 {
     for (int index_count = file_number; index_count < 10000; ++index_count)
@@ -181,10 +141,12 @@ region_ptr vanilla_index::index_for(std::int32_t cycle, std::int32_t file_number
     {
         auto cycle_ = std::get<0>(k);
         auto file_number_ = std::get<1>(k);
-        auto && path = make_file(m_settings.path(),
+        auto && path = make_file(m_settings,
                                  m_settings.cycle_format().date_from_cycle(cycle_),
                                  (util::streamer() << INDEX_FILE_NAME_PREFIX << file_number_).str(),
                                  append);
+        if(append)
+            m_directory.add_index_file(cycle_, file_number_);
         return !path.empty()
                 ? std::make_shared<region>(path, 1LL << m_index_block_size_bits, file_number_)
                 : region_ptr();
@@ -33,13 +33,14 @@ namespace cornelich
 class region;
 using region_ptr = std::shared_ptr<region>;
 class vanilla_chronicle_settings;
+class vanilla_directory;
 
 /// This class manages the chronicle index files (mmaped regions)
 class vanilla_index
 {
 public:
     /// Create an index-region manager using the given settings and desired region size
-    vanilla_index(const vanilla_chronicle_settings & settings, std::int32_t index_block_size_bits);
+    vanilla_index(const vanilla_chronicle_settings & settings, vanilla_directory & directory, std::int32_t index_block_size_bits);
 
     std::int32_t find_first_cycle() const;
     std::int32_t find_last_cycle() const;
@@ -62,12 +63,17 @@ public:
     /// Return the number of (non-zero) index entries in the given region
     static std::int64_t count_index_entries(const region & region);
 
+    /// Return the position of the last (non-zero) entry in the given region or -1 if it is empty.
+    /// The entries get appended in order so this is a binary search.
+    static std::int64_t find_last_entry(const region & region);
+
     /// Attempt to atomically append (CAS) a value in the index region
     /// Return offset at which the value was appended or -1 on failure (e.g. region full)
     static std::int64_t append(region & region, std::int64_t index_value);
 
 private:
     const vanilla_chronicle_settings & m_settings;
+    vanilla_directory & m_directory;
     const std::int32_t m_index_block_size_bits;
     using mutex_t = util::spin_lock;
     mutex_t m_lock;
@@ -0,0 +1,104 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "vanilla_time_index.h"
+
+#include "vanilla_chronicle_settings.h"
+#include "vanilla_date.h"
+#include "vanilla_utils.h"
+#include "region.h"
+
+#include "util/streamer.h"
+
+#include <mutex>
+#include <stdexcept>
+
+namespace cornelich
+{
+
+namespace
+{
+
+std::int32_t time_interval_bits(const vanilla_chronicle_settings & settings, std::int32_t index_block_longs_bits)
+{
+    const auto interval = settings.time_index_interval();
+    if(!interval)
+        return -1;
+    if(interval < 0 || (interval & (interval - 1)) || interval > (1 << index_block_longs_bits))
+        throw std::invalid_argument(util::streamer() << "Time index interval must be a power of 2 not exceeding the index block entries: " << interval);
+    return __builtin_ctz(static_cast<unsigned>(interval));
+}
+
+}
+
+vanilla_time_index::vanilla_time_index(const vanilla_chronicle_settings & settings, std::int32_t index_block_longs_bits)
+    : m_settings(settings)
+    , m_interval_bits(time_interval_bits(settings, index_block_longs_bits))
+    , m_interval_mask(enabled() ? (INT64_C(1) << m_interval_bits) - 1 : 0)
+    , m_region_size(enabled() ? (1 << (index_block_longs_bits - m_interval_bits)) * 8 : 0)
+    , m_cache(settings.index_cache_size(), region_ptr_validator())
+{
+}
+
+region_ptr vanilla_time_index::time_for(std::int32_t cycle, std::int32_t file_number, bool append)
+{
+    if(!enabled())
+        return {};
+
+    std::lock_guard<mutex_t> lk(m_lock);
+    auto key = std::make_pair(cycle, file_number);
+    auto && creator = [this, append](const key_t & k)
+    {
+        auto cycle_ = std::get<0>(k);
+        auto file_number_ = std::get<1>(k);
+        auto && path = make_file(m_settings,
+                                 m_settings.cycle_format().date_from_cycle(cycle_),
+                                 (util::streamer() << TIME_FILE_NAME_PREFIX << file_number_).str(),
+                                 append);
+        return !path.empty()
+                ? std::make_shared<region>(path, m_region_size, file_number_)
+                : region_ptr();
+    };
+
+    return m_cache.get(key, creator);
+}
+
+std::int64_t vanilla_time_index::find_last_before(const region & region, std::int64_t time)
+{
+    // The slots get recorded in order (up to the races between appenders) - so a binary search
+    // over the recorded ones for the last time before the given one
+    std::int64_t lo = 0;
+    std::int64_t hi = (region.size() >> 3) - 1;
+    std::int64_t found = -1;
+    while(lo <= hi)
+    {
+        const auto mid = lo + (hi - lo) / 2;
+        const auto recorded = region.read_ordered64(static_cast<std::int32_t>(mid << 3));
+        if(recorded && recorded < time)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "region_utils.h"
+
+#include "util/cache.h"
+#include "util/spin_lock.h"
+
+#include <cstdint>
+#include <memory>
+#include <tuple>
+
+namespace cornelich
+{
+
+class region;
+using region_ptr = std::shared_ptr<region>;
+class vanilla_chronicle_settings;
+
+/**
+ * This class manages the sparse time index files (mmaped regions).
+ * The file time-N next to index-N holds the time (microseconds since the epoch) at which every interval-th
+ * entry of the index file got appended - slot k for the entry k * interval. Slots not recorded (yet) are 0.
+ */
+class vanilla_time_index
+{
+public:
+    /// Create a time-index manager for index files of (1 << index_block_longs_bits) entries
+    vanilla_time_index(const vanilla_chronicle_settings & settings, std::int32_t index_block_longs_bits);
+
+    /// Whether the time gets recorded at all
+    bool enabled() const { return m_interval_bits >= 0; }
+    /// log2 of the interval between the recorded entries
+    std::int32_t interval_bits() const { return m_interval_bits; }
+
+    /// Whether the time of the entry at the given position of an index file (0, 1, ...) gets recorded
+    bool sampled(std::int64_t entry) const { return enabled() && (entry & m_interval_mask) == 0; }
+
+    /// Return a pointer to the time region of a specific (cycle, index file number).
+    /// If there is no such region AND append is false an empty pointer shall be returned.
+    region_ptr time_for(std::int32_t cycle, std::int32_t file_number, bool append);
+
+    /// Return the last recorded slot with a time before the given one or -1 if there is none
+    static std::int64_t find_last_before(const region & region, std::int64_t time);
+
+private:
+    const vanilla_chronicle_settings & m_settings;
+    const std::int32_t m_interval_bits;
+    const std::int64_t m_interval_mask;
+    const std::int32_t m_region_size;
+    using mutex_t = util::spin_lock;
+    mutex_t m_lock;
+    using key_t = std::tuple<std::int32_t, std::int32_t>;
+    util::cache<key_t, region_ptr, region_ptr_validator> m_cache;
+};
+
+}
@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "vanilla_utils.h"
 
+#include "vanilla_chronicle_settings.h"
+
 #include "util/streamer.h"
 
 #include <boost/filesystem/operations.hpp>
@@ -61,6 +63,22 @@ std::string make_file(const std::string & base_path,
     return file.string();
 }
 
+std::string make_file(const vanilla_chronicle_settings & settings,
+                      const std::string & cycle_string,
+                      const std::string & file_name,
+                      bool append)
+{
+    if(settings.active_path().empty())
+        return make_file(settings.path(), cycle_string, file_name, append);
+
+    // The base path first - a moved file is found there while the tier_mover removes the copy in the
+    // active tier only in a later pass, so a file found in either tier is still there when it gets mapped
+    auto file = make_file(settings.path(), cycle_string, file_name, false);
+    if(file.empty())
+        file = make_file(settings.active_path(), cycle_string, file_name, append);
+    return file;
+}
+
 std::int32_t cycle_for_now(std::int32_t cycle_length)
 {
     using namespace std::chrono;
@@ -68,4 +86,10 @@ std::int32_t cycle_for_now(std::int32_t cycle_length)
     return static_cast<std::int32_t>(now.count() / cycle_length);
 }
 
+std::int64_t micros_for_now()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(system_clock::now().time_since_epoch()).count();
+}
+
 }
@@ -23,6 +23,8 @@ limitations under the License.
 namespace cornelich
 {
 
+class vanilla_chronicle_settings;
+
 /**
  * Return a path to a file in the chronicle folder (located under base_path/cycle_string/file_name).
  * Depending on the append parameter value:
@@ -38,8 +40,21 @@ std::string make_file(const std::string & base_path,
                       const std::string & file_name,
                       bool append);
 
+/**
+ * Return a path to a file of the chronicle cycle (see make_file() above) looking it up in both tiers
+ * when the chronicle has an active tier (see vanilla_chronicle_settings::active_path()):
+ * the base path first, then the active tier. The files to append to get created in the active tier.
+ */
+std::string make_file(const vanilla_chronicle_settings & settings,
+                      const std::string & cycle_string,
+                      const std::string & file_name,
+                      bool append);
+
 
 /// Return a cycle number corresponding to the current time
 std::int32_t cycle_for_now(std::int32_t cycle_length);
 
+/// Return the current time in microseconds since the epoch
+std::int64_t micros_for_now();
+
 }
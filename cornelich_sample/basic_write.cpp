@@ -28,7 +28,9 @@ int main()
     chr::vanilla_chronicle chronicle(settings);
 
     auto appender = chronicle.create_appender();
-    appender.start_excerpt(1024);
+    // Returns false only when the excerpt gets dropped because of max_lead() - not used here
+    if(!appender.start_excerpt(1024))
+        return 1;
     appender.write(42);
     appender.write("Some text", chr::writers::chars());
     appender.finish();
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cornelich/vanilla_chronicle.h>
 #include <cornelich/vanilla_date.h>
 #include <cornelich/formatters.h>
+#include <cornelich/ring_chronicle.h>
 
 #include <cornelich/util/stop_bit.h>
 #include <cornelich/util/math_util.h>
@@ -29,6 +30,7 @@ limitations under the License.
 
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 #include <thread>
 #include <string>
@@ -41,40 +43,37 @@ void configure_parser(cli::Parser & parser)
     parser.set_optional<std::size_t>("n", "max-count", 10000000, "Number of entries written");
     parser.set_optional<std::size_t>("w", "writer-threads", 4, "Number of writer threads");
     parser.set_optional<bool>("x", "delete", false, "Delete the input chronicle at startup");
+    parser.set_optional<std::size_t>("s", "ring-slots", 0, "Write a ring chronicle of that many slots instead (e.g. -o /dev/shm/chr)");
 }
 
-int main(int argc, char **argv)
-{
-    cli::Parser parser(argc, argv);
-    configure_parser(parser);
-    parser.run_and_exit_if_error();
-
-    const auto path = parser.get<std::string>("o");
+/// Slot size of the ring chronicle - big enough for the excerpts written below
+const std::int32_t RING_SLOT_SIZE = 64;
 
-    if(parser.get<bool>("x"))
-        boost::filesystem::remove_all(path);
+/// Start an excerpt - a vanilla appender only drops it when bounded by max_lead() (not used here)
+void start(excerpt_appender & appender, std::int32_t capacity)
+{
+    if(!appender.start_excerpt(capacity))
+        throw std::runtime_error("Excerpt dropped");
+}
 
-    vanilla_chronicle_settings settings(path);
-    settings.thread_id_bits(16);
-    vanilla_chronicle chr(settings);
+void start(ring_appender & appender, std::int32_t capacity)
+{
+    appender.start_excerpt(capacity);
+}
 
+template <typename CHRONICLE>
+void write(CHRONICLE & chr, std::size_t writer_thread_count, std::size_t max_count, std::int32_t capacity)
+{
     std::vector<std::thread> threads;
-    const auto writer_thread_count = parser.get<std::size_t>("w");
-    const auto max_count = parser.get<std::size_t>("n");
-
-    using std::chrono::steady_clock;
-    auto t0 = steady_clock::now();
-
-
     for(auto tid = 0u; tid != writer_thread_count; ++tid)
     {
-        threads.push_back(std::thread([&chr, tid, settings, max_count]()
+        threads.push_back(std::thread([&chr, tid, max_count, capacity]()
         {
             auto appender = chr.create_appender();
 
             for(auto i = 0u; i != max_count; ++i)
             {
-                appender.start_excerpt(8192);
+                start(appender, capacity);
                 appender.write(tid);
                 appender.write(i, util::stop_bit::write);
                 appender.write(0x0badcafedeadbeef);
@@ -89,6 +88,39 @@ int main(int argc, char **argv)
     {
         thread.join();
     }
+}
+
+int main(int argc, char **argv)
+{
+    cli::Parser parser(argc, argv);
+    configure_parser(parser);
+    parser.run_and_exit_if_error();
+
+    const auto path = parser.get<std::string>("o");
+
+    if(parser.get<bool>("x"))
+        boost::filesystem::remove_all(path);
+
+    const auto writer_thread_count = parser.get<std::size_t>("w");
+    const auto max_count = parser.get<std::size_t>("n");
+    const auto ring_slots = parser.get<std::size_t>("s");
+
+    using std::chrono::steady_clock;
+    auto t0 = steady_clock::now();
+
+    if(ring_slots != 0)
+    {
+        ring_chronicle chr(path, static_cast<std::int32_t>(ring_slots), RING_SLOT_SIZE);
+        write(chr, writer_thread_count, max_count, RING_SLOT_SIZE);
+    }
+    else
+    {
+        vanilla_chronicle_settings settings(path);
+        settings.thread_id_bits(16);
+        vanilla_chronicle chr(settings);
+        write(chr, writer_thread_count, max_count, 8192);
+    }
+
     auto t1 = steady_clock::now();
     auto diff = t1 - t0;
     std::cout << std::chrono::duration<double, std::milli>(diff).count() << " ms" << std::endl;
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cornelich/vanilla_chronicle.h>
 #include <cornelich/vanilla_date.h>
 #include <cornelich/formatters.h>
+#include <cornelich/ring_chronicle.h>
 
 #include <cornelich/util/stop_bit.h>
 #include <cornelich/util/math_util.h>
@@ -28,9 +29,12 @@ limitations under the License.
 #include <cmdparser/cmdparser.hpp>
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <map>
+#include <stdexcept>
 #include <vector>
 #include <thread>
 #include <string>
@@ -47,57 +51,114 @@ void configure_parser(cli::Parser & parser)
     parser.set_optional<std::size_t>("w", "writer-threads", 4, "Number of writer threads");
     parser.set_optional<std::size_t>("r", "reader-threads", 4, "Number of reader threads");
     parser.set_optional<bool>("x", "delete", false, "Delete the input chronicle at startup");
+    parser.set_optional<std::size_t>("s", "ring-slots", 0, "Read a ring chronicle of that many slots instead (e.g. -i /dev/shm/chr)");
 }
 
-int main(int argc, char **argv)
+/// Slot size of the ring chronicle - the same as in ping
+const std::int32_t RING_SLOT_SIZE = 64;
+
+/// The excerpts a tailer could not read - none for a vanilla chronicle
+std::uint64_t lost(const excerpt_tailer &) { return 0; }
+std::uint64_t lost(const ring_tailer & tailer) { return tailer.lost(); }
+
+/// An excerpt as written by ping
+struct ping_excerpt
 {
-    cli::Parser parser(argc, argv);
-    configure_parser(parser);
-    parser.run_and_exit_if_error();
+    std::int32_t id;
+    std::int64_t val;
+    std::int64_t long_value;
+    boost::string_ref text1;
+    boost::string_ref text2;
+};
 
-    const auto path = parser.get<std::string>("i");
+/// Space for a copy of a ring excerpt - zeroes past the excerpt stop a stop bit number read from garbage
+using excerpt_copy = std::array<std::uint8_t, RING_SLOT_SIZE + 16>;
 
-    if(parser.get<bool>("x"))
-        boost::filesystem::remove_all(path);
+/// The data of the current excerpt - the excerpts of a vanilla chronicle stay as they are
+const std::uint8_t * excerpt_data(excerpt_tailer & tailer, excerpt_copy &) { return tailer.buffer().data(); }
+
+/// A copy of the current excerpt or nullptr if it has been overwritten meanwhile (checked after copying)
+const std::uint8_t * excerpt_data(ring_tailer & tailer, excerpt_copy & copy)
+{
+    if(tailer.limit() < 0 || tailer.limit() > RING_SLOT_SIZE)
+    {
+        // The length of the excerpt overwriting this one - unless it is still intact
+        if(tailer.valid())
+            throw std::logic_error("Excerpt longer than a slot");
+        return nullptr;
+    }
+    copy.fill(0);
+    std::memcpy(copy.data(), tailer.buffer().data(), static_cast<std::size_t>(tailer.limit()));
+    return tailer.valid() ? copy.data() : nullptr;
+}
 
-    vanilla_chronicle_settings settings(path);
-    settings.thread_id_bits(16);
-    vanilla_chronicle chr(settings);
+/// Read the fields of an excerpt - every one of them within the limit. False if they do not fit.
+bool parse(const std::uint8_t * data, std::int32_t limit, ping_excerpt & e)
+{
+    std::int32_t position = 0;
+    if(position + static_cast<std::int32_t>(sizeof(e.id)) > limit)
+        return false;
+    std::memcpy(&e.id, data + position, sizeof(e.id));
+    position += static_cast<std::int32_t>(sizeof(e.id));
+    e.val = util::stop_bit::read(data, position);
+    if(position + static_cast<std::int32_t>(sizeof(e.long_value)) > limit)
+        return false;
+    std::memcpy(&e.long_value, data + position, sizeof(e.long_value));
+    position += static_cast<std::int32_t>(sizeof(e.long_value));
+    e.text1 = readers::chars()(data, position);
+    if(position > limit)
+        return false;
+    e.text2 = readers::chars()(data, position);
+    return position <= limit;
+}
 
+template <typename CHRONICLE>
+void read(CHRONICLE & chr, std::size_t reader_thread_count, std::size_t max_count)
+{
     std::vector<std::thread> threads;
-    const auto reader_thread_count = parser.get<std::size_t>("r");
-    const auto max_count = parser.get<std::size_t>("w") * parser.get<std::size_t>("n");
-    std::cout << "About to start reading from " << path << '\n';
     for(auto tid = 0u; tid != reader_thread_count; ++tid)
     {
-        threads.push_back(std::thread([&chr, tid, settings, max_count]()
+        threads.push_back(std::thread([&chr, tid, max_count]()
         {
-            //std::this_thread::sleep_for(std::chrono::milliseconds(10*tid));
             using std::chrono::steady_clock;
             auto t0 = steady_clock::now();
 
-            std::map<int, int> counts;
+            std::map<int, std::int64_t> counts;
             auto tailer = chr.create_tailer();
+            excerpt_copy copy;
+            ping_excerpt e;
 
             auto count = 0u;
-            while(count != max_count)
+            // Excerpts overwritten in a ring chronicle while being read
+            auto overwritten = 0u;
+            while(count + overwritten + lost(tailer) != max_count)
             {
                 if(!tailer.next_index())
                     continue;
-                const auto id = tailer.read<std::int32_t>();
-                const auto val = tailer.read(util::stop_bit::read);
-                const auto long_value = tailer.read<std::int64_t>();
-                const auto text1 = tailer.read(readers::chars());
-                const auto text2 = tailer.read(readers::chars());
+                const auto * data = excerpt_data(tailer, copy);
+                if(BOOST_UNLIKELY(!data))
+                {
+                    ++overwritten;
+                    continue;
+                }
+                // The excerpts of a writer come in order - with gaps only if some have been lost
+                if(BOOST_UNLIKELY(!parse(data, tailer.limit(), e)))
+                {
+                    std::cerr << "Truncated excerpt\n";
+                    return 1;
+                }
+                auto & expected = counts[e.id];
                 if(BOOST_UNLIKELY(
-                        counts[id]++ != val
-                            || long_value != 0x0badcafedeadbeef
-                            || text1 != boost::string_ref(EXPECTED1)
-                            || text2 != boost::string_ref(EXPECTED2) ))
+                        e.val < expected
+                            || (e.val != expected && lost(tailer) + overwritten == 0)
+                            || e.long_value != 0x0badcafedeadbeef
+                            || e.text1 != boost::string_ref(EXPECTED1)
+                            || e.text2 != boost::string_ref(EXPECTED2) ))
                 {
                     std::cerr << "Unexpected value\n";
                     return 1;
                 }
+                expected = e.val + 1;
                 ++count;
                 if(count % 1000000 == 0)
                 {
@@ -108,7 +169,10 @@ int main(int argc, char **argv)
             }
             auto t1 = steady_clock::now();
             auto diff = t1 - t0;
-            std::cout << std::chrono::duration<double, std::milli>(diff).count() << " ms" << std::endl;
+            std::cout << std::chrono::duration<double, std::milli>(diff).count() << " ms";
+            if(count != max_count)
+                std::cout << " (" << max_count - count << " excerpts lost)";
+            std::cout << std::endl;
             return 0;
         }));
     }
@@ -117,3 +181,33 @@ int main(int argc, char **argv)
         thread.join();
     }
 }
+
+int main(int argc, char **argv)
+{
+    cli::Parser parser(argc, argv);
+    configure_parser(parser);
+    parser.run_and_exit_if_error();
+
+    const auto path = parser.get<std::string>("i");
+
+    if(parser.get<bool>("x"))
+        boost::filesystem::remove_all(path);
+
+    const auto reader_thread_count = parser.get<std::size_t>("r");
+    const auto max_count = parser.get<std::size_t>("w") * parser.get<std::size_t>("n");
+    const auto ring_slots = parser.get<std::size_t>("s");
+    std::cout << "About to start reading from " << path << '\n';
+
+    if(ring_slots != 0)
+    {
+        ring_chronicle chr(path, static_cast<std::int32_t>(ring_slots), RING_SLOT_SIZE);
+        read(chr, reader_thread_count, max_count);
+    }
+    else
+    {
+        vanilla_chronicle_settings settings(path);
+        settings.thread_id_bits(16);
+        vanilla_chronicle chr(settings);
+        read(chr, reader_thread_count, max_count);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cmdparser/cmdparser.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cornelich;
+
+void configure_parser(cli::Parser & parser)
+{
+    parser.set_optional<std::string>("o", "output", "/tmp/__test/tailer_bench", "Chronicle path (deleted at startup)");
+    parser.set_optional<std::size_t>("n", "max-count", 1000000, "Total number of entries written");
+    parser.set_optional<std::size_t>("w", "writers", 8, "Number of (interleaved) writers");
+    parser.set_optional<std::size_t>("s", "size", 128, "Size of each excerpt");
+    parser.set_optional<std::size_t>("r", "rounds", 3, "Number of read passes for each prefetch distance");
+}
+
+int main(int argc, char **argv)
+{
+    cli::Parser parser(argc, argv);
+    configure_parser(parser);
+    parser.run_and_exit_if_error();
+
+    const auto path = parser.get<std::string>("o");
+    const auto max_count = parser.get<std::size_t>("n");
+    const auto writer_count = parser.get<std::size_t>("w");
+    const auto size = parser.get<std::size_t>("s");
+    const auto rounds = parser.get<std::size_t>("r");
+
+    boost::filesystem::remove_all(path);
+
+    vanilla_chronicle_settings settings(path);
+    settings.thread_id_bits(23);
+    vanilla_chronicle chr(settings);
+
+    // Writers picked at random so that consecutive excerpts live in different data files
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto w = 0u; w != writer_count; ++w)
+            appenders.emplace_back(new excerpt_appender(chr.create_appender(chr.first_writer_id() + static_cast<std::int32_t>(w))));
+
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<std::size_t> pick(0, writer_count - 1);
+        const std::vector<std::uint8_t> payload(size, 0xab);
+        for(auto i = 0u; i != max_count; ++i)
+        {
+            auto & appender = *appenders[pick(rng)];
+            appender.start_excerpt(static_cast<std::int32_t>(size));
+            std::memcpy(appender.buffer().data(), payload.data(), size);
+            appender.buffer().position() = static_cast<std::int32_t>(size);
+            appender.finish();
+        }
+    }
+
+    using std::chrono::steady_clock;
+    for(auto distance : {0, 1, 2, 4, 8, 16})
+    {
+        auto best = steady_clock::duration::max();
+        std::uint64_t checksum = 0;
+        for(auto round = 0u; round != rounds; ++round)
+        {
+            auto tailer = chr.create_tailer();
+            tailer.prefetch_distance(distance);
+            tailer.to_start();
+
+            auto t0 = steady_clock::now();
+            std::size_t count = 0;
+            while(tailer.next_index())
+            {
+                checksum += tailer.read<std::uint8_t>();
+                ++count;
+            }
+            auto elapsed = steady_clock::now() - t0;
+            if(count != max_count)
+            {
+                std::cerr << "Read " << count << " entries, expected " << max_count << std::endl;
+                return 1;
+            }
+            if(elapsed < best)
+                best = elapsed;
+        }
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(best).count();
+        std::cout << "prefetch distance " << distance << ": "
+                  << static_cast<double>(ns) / max_count << " ns/excerpt"
+                  << " (" << ns / 1000000 << " ms, checksum " << checksum << ")" << std::endl;
+    }
+}
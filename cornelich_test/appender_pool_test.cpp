@@ -0,0 +1,197 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/appender_pool.h>
+
+#include "write_test_data.h"
+
+#include <cstdint>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE_METHOD(clean_up_fixture, "Using appender_pool to write data into the chronicle", "[appender_pool]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 20);
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+    const auto first = test_writer_id(chronicle, 0);
+
+    SECTION("Invalid pools")
+    {
+        REQUIRE_THROWS_AS(appender_pool(chronicle, 0, first), std::invalid_argument);
+        REQUIRE_THROWS_AS(appender_pool(chronicle, 2, -1), std::invalid_argument);
+        REQUIRE_THROWS_AS(appender_pool(chronicle, 2, static_cast<std::int32_t>(settings.thread_id_mask())), std::invalid_argument);
+        // Below the fixed ids
+        REQUIRE_THROWS_AS(appender_pool(chronicle, 2, 100), std::invalid_argument);
+        // The ids of another pool
+        appender_pool pool(chronicle, 2, first);
+        REQUIRE_THROWS_AS(appender_pool(chronicle, 2, first + 1), std::runtime_error);
+    }
+
+    SECTION("Default thread id bits")
+    {
+        vanilla_chronicle_settings defaults((path() / "defaults").c_str());
+        vanilla_chronicle default_chronicle(defaults);
+        const auto default_first = default_chronicle.first_writer_id();
+        const auto mask = static_cast<std::int32_t>(defaults.thread_id_mask());
+        if(default_first + 1 <= mask)
+        {
+            // pid_max below 65536 - the default bits are enough
+            appender_pool pool(default_chronicle, 2, default_first);
+            auto lease = pool.start_excerpt(8);
+            lease.write(1);
+            REQUIRE(lease.finish() >= 0);
+        }
+        else
+        {
+            REQUIRE_THROWS_AS(appender_pool(default_chronicle, 2, default_first), std::invalid_argument);
+        }
+
+        // The range is checked as a whole before any lane is created
+        try
+        {
+            appender_pool(default_chronicle, 2, mask);
+            FAIL("The writer ids do not fit the thread id bits");
+        }
+        catch(const std::invalid_argument & e)
+        {
+            REQUIRE(std::string(e.what()).find("thread_id_bits") != std::string::npos);
+        }
+    }
+
+    SECTION("Lanes write with fixed writer ids")
+    {
+        appender_pool pool(chronicle, 2, first);
+        REQUIRE(pool.lanes() == 2);
+        {
+            auto lease = pool.start_excerpt(128);
+            REQUIRE(lease.appender().writer_id() >= first);
+            REQUIRE(lease.appender().writer_id() <= first + 1);
+            lease.write(42);
+            REQUIRE(lease.finish() >= 0);
+            REQUIRE_THROWS_AS(lease.finish(), std::logic_error);
+        }
+
+        std::set<std::string> files;
+        for(fs::recursive_directory_iterator it(path()), end; it != end; ++it)
+        {
+            if(fs::is_regular_file(*it))
+                files.insert(it->path().filename().string());
+        }
+        REQUIRE((files.count(DATA_FILE_NAME_PREFIX + std::to_string(first) + "-0") + files.count(DATA_FILE_NAME_PREFIX + std::to_string(first + 1) + "-0")) == 1);
+    }
+
+    SECTION("A dropped excerpt releases the lane")
+    {
+        appender_pool pool(chronicle, 1, first);
+        for(auto i = 0; i != 3; ++i)
+        {
+            auto lease = pool.start_excerpt(8);
+            REQUIRE(!!lease);
+            lease.write(i);
+            lease.finish();
+        }
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.next_index());
+        tailer.checkpoint("consumer");
+        {
+            auto lease = pool.start_excerpt(8);
+            lease.appender().max_lead(2, excerpt_appender::lead_policy::drop);
+        }
+        auto dropped = pool.start_excerpt(8);
+        REQUIRE(!dropped);
+        REQUIRE_THROWS_AS(dropped.finish(), std::logic_error);
+        REQUIRE_THROWS_AS(dropped.appender(), std::logic_error);
+        REQUIRE_THROWS_AS(dropped.write(1), std::logic_error);
+        // The lane is free again - once the consumer catches up the excerpt goes through
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.next_index());
+        tailer.checkpoint("consumer");
+        auto lease = pool.start_excerpt(8);
+        REQUIRE(!!lease);
+        REQUIRE(lease.appender().dropped() == 1);
+        lease.write(3);
+        REQUIRE(lease.finish() >= 0);
+    }
+
+    SECTION("Excerpts can migrate between threads")
+    {
+        appender_pool pool(chronicle, 1, first);
+        auto lease = pool.start_excerpt(128);
+        lease.write(1);
+        std::thread t([&lease]()
+        {
+            lease.write(2);
+            lease.finish();
+        });
+        t.join();
+
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.limit() == 8);
+        REQUIRE(tailer.read<std::int32_t>() == 1);
+        REQUIRE(tailer.read<std::int32_t>() == 2);
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("Many threads share fewer lanes")
+    {
+        constexpr auto THREAD_COUNT = 8u;
+        constexpr auto ITER_COUNT = 5000u;
+        appender_pool pool(chronicle, 3, first);
+        std::vector<std::thread> threads;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+        {
+            threads.push_back(std::thread([&pool, tid]()
+            {
+                for(auto i = 0u; i != ITER_COUNT; ++i)
+                {
+                    auto lease = pool.start_excerpt(64);
+                    lease.write(tid);
+                    lease.write(i);
+                    lease.finish();
+                }
+            }));
+        }
+        for(auto & thread : threads)
+            thread.join();
+
+        std::vector<std::uint32_t> counts(THREAD_COUNT, 0);
+        auto tailer = chronicle.create_tailer();
+        while(tailer.next_index())
+        {
+            auto idx = tailer.read<std::uint32_t>();
+            auto val = tailer.read<std::uint32_t>();
+            REQUIRE(counts[idx]++ == val);
+        }
+        for(std::uint32_t i = 0; i != THREAD_COUNT; ++i)
+            REQUIRE(counts[i] == ITER_COUNT);
+    }
+}
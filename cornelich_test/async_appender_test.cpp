@@ -0,0 +1,194 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/async_appender.h>
+#include <cornelich/formatters.h>
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE_METHOD(clean_up_fixture, "Using async_appender to write data into the chronicle", "[async_appender]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.data_block_size(1ULL << 20);
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    SECTION("Excerpts are written in the order of their sequence numbers")
+    {
+        std::mutex lock;
+        std::map<std::uint64_t, std::int64_t> indices;
+        {
+            async_appender appender(chronicle, 16, 64, async_appender::full_policy::yield,
+                                    [&lock, &indices](std::uint64_t seq, std::int64_t idx)
+                                    {
+                                        std::lock_guard<std::mutex> lk(lock);
+                                        indices[seq] = idx;
+                                    });
+            for(std::int32_t i = 0; i != 1000; ++i)
+            {
+                auto excerpt = appender.start_excerpt(64);
+                REQUIRE(!!excerpt);
+                excerpt.write(i);
+                excerpt.write("text", writers::chars());
+                REQUIRE(excerpt.finish() == static_cast<std::uint64_t>(i));
+            }
+            {
+                // Abandoned excerpts are skipped
+                auto excerpt = appender.start_excerpt(64);
+                excerpt.write(-1);
+            }
+            appender.flush();
+            REQUIRE(appender.written() == 1000);
+            REQUIRE_THROWS_AS(appender.start_excerpt(65), std::invalid_argument);
+        }
+
+        REQUIRE(indices.size() == 1000);
+        auto tailer = chronicle.create_tailer();
+        for(std::int32_t i = 0; i != 1000; ++i)
+        {
+            REQUIRE(tailer.next_index());
+            REQUIRE(tailer.index() == indices[static_cast<std::uint64_t>(i)]);
+            REQUIRE(tailer.read<std::int32_t>() == i);
+            REQUIRE(tailer.read(readers::chars()) == "text");
+        }
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("Excerpts can be dropped when the ring is full")
+    {
+        async_appender appender(chronicle, 4, 64, async_appender::full_policy::drop);
+        std::vector<async_appender::excerpt> excerpts;
+        for(auto i = 0; i != 4; ++i)
+        {
+            excerpts.push_back(appender.start_excerpt(8));
+            REQUIRE(!!excerpts.back());
+        }
+        auto dropped = appender.start_excerpt(8);
+        REQUIRE(!dropped);
+        REQUIRE_THROWS_AS(dropped.finish(), std::logic_error);
+        REQUIRE(appender.dropped() == 1);
+        for(auto & e : excerpts)
+            e.finish();
+        appender.flush();
+        REQUIRE(appender.written() == 4);
+    }
+
+    SECTION("Flushing with an open excerpt")
+    {
+        async_appender appender(chronicle, 16, 64);
+        auto first = appender.start_excerpt(8);
+        first.write(1);
+        first.finish();
+        auto open = appender.start_excerpt(8);
+        auto behind = appender.start_excerpt(8);
+        behind.write(3);
+        behind.finish();
+        // Only up to the open excerpt
+        appender.flush();
+        REQUIRE(appender.written() == 1);
+        open.write(2);
+        open.finish();
+        appender.flush();
+        REQUIRE(appender.written() == 3);
+    }
+
+    SECTION("Writing past the capacity")
+    {
+        async_appender appender(chronicle, 16, 64);
+        auto excerpt = appender.start_excerpt(6);
+        excerpt.write(std::int32_t(1));
+        REQUIRE_THROWS_AS(excerpt.write(std::int32_t(2)), std::logic_error);
+        REQUIRE(excerpt.position() == 4);
+        excerpt.write(std::int16_t(2));
+        excerpt.finish();
+        REQUIRE_THROWS_AS(appender.start_excerpt(4).write(std::int64_t(1)), std::logic_error);
+    }
+
+    SECTION("An error on the journaling thread")
+    {
+        async_appender appender(chronicle, 4, 64, async_appender::full_policy::spin,
+                                [](std::uint64_t seq, std::int64_t)
+                                {
+                                    if(seq == 1)
+                                        throw std::runtime_error("Callback failed");
+                                });
+        for(std::int32_t i = 0; i != 3; ++i)
+        {
+            auto excerpt = appender.start_excerpt(8);
+            excerpt.write(i);
+            excerpt.finish();
+        }
+        // The journaling thread has stopped at the second excerpt - nothing would ever drain the ring
+        REQUIRE_THROWS_AS(appender.flush(), std::runtime_error);
+        REQUIRE_THROWS_AS(appender.start_excerpt(8), std::runtime_error);
+        // Both excerpts got into the chronicle before the callback threw
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 1);
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("Multiple producers")
+    {
+        constexpr auto THREAD_COUNT = 4u;
+        constexpr auto ITER_COUNT = 10000u;
+        {
+            async_appender appender(chronicle, 256, 16);
+            std::vector<std::thread> threads;
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            {
+                threads.push_back(std::thread([&appender, tid]()
+                {
+                    for(auto i = 0u; i != ITER_COUNT; ++i)
+                    {
+                        auto excerpt = appender.start_excerpt(8);
+                        excerpt.write(tid);
+                        excerpt.write(i);
+                        excerpt.finish();
+                    }
+                }));
+            }
+            for(auto & thread : threads)
+                thread.join();
+        }
+
+        std::vector<std::uint32_t> counts(THREAD_COUNT, 0);
+        auto tailer = chronicle.create_tailer();
+        while(tailer.next_index())
+        {
+            auto idx = tailer.read<std::uint32_t>();
+            auto val = tailer.read<std::uint32_t>();
+            REQUIRE(counts[idx]++ == val);
+        }
+        for(std::uint32_t i = 0; i != THREAD_COUNT; ++i)
+            REQUIRE(counts[i] == ITER_COUNT);
+    }
+}
@@ -0,0 +1,153 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/bundle.h>
+#include <cornelich/formatters.h>
+
+#include <cstdint>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE_METHOD(clean_up_fixture, "Packing small messages into bundles", "[bundle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.data_block_size(1ULL << 20);
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    SECTION("Bundles are published when full, on flush and on destruction")
+    {
+        {
+            bundle_appender appender(chronicle, 1024, 10);
+            for(std::int32_t i = 0; i != 25; ++i)
+            {
+                appender.start_excerpt(16);
+                appender.write(i);
+                appender.write(static_cast<std::int64_t>(i) * 3);
+                appender.finish();
+            }
+            REQUIRE(appender.pending() == 5);
+            appender.start_excerpt(16);
+            appender.write(-1);
+        }
+
+        // 3 bundles (10 + 10 + 5 messages)
+        auto tailer = chronicle.create_tailer();
+        auto excerpts = 0;
+        while(tailer.next_index())
+            ++excerpts;
+        REQUIRE(excerpts == 3);
+
+        bundle_tailer bundles(chronicle);
+        for(std::int32_t i = 0; i != 25; ++i)
+        {
+            REQUIRE(bundles.next_index());
+            REQUIRE(bundles.sub_index() == i % 10);
+            REQUIRE(bundles.limit() == 12);
+            REQUIRE(bundles.read<std::int32_t>() == i);
+            REQUIRE(bundles.read<std::int64_t>() == i * 3);
+        }
+        REQUIRE(!bundles.next_index());
+
+        SECTION("Composite positions")
+        {
+            bundle_tailer other(chronicle);
+            other.to_start();
+            REQUIRE(other.next_index());
+            const auto first = other.index();
+            REQUIRE(other.index(first + 1, 4));
+            REQUIRE(other.read<std::int32_t>() == 14);
+            REQUIRE(other.next_index());
+            REQUIRE(other.index() == first + 1);
+            REQUIRE(other.sub_index() == 5);
+            REQUIRE(other.read<std::int32_t>() == 15);
+            REQUIRE(!other.index(first + 2, 5));
+        }
+    }
+
+    SECTION("A bundle that cannot fit the next message is published first")
+    {
+        bundle_appender appender(chronicle, 48, 100);
+        for(std::int32_t i = 0; i != 3; ++i)
+        {
+            appender.start_excerpt(20);
+            appender.write("0123456789", writers::chars());
+            appender.finish();
+        }
+        // A message bigger than the bundle capacity gets a bundle of its own
+        appender.start_excerpt(1000);
+        appender.buffer().position() += 1000;
+        appender.finish();
+        REQUIRE_THROWS_AS(appender.start_excerpt(BUNDLE_MAX_MESSAGE_SIZE + 1), std::invalid_argument);
+        appender.flush();
+
+        bundle_tailer bundles(chronicle);
+        std::int64_t last_index = -1;
+        auto bundle_count = 0;
+        for(auto i = 0; i != 3; ++i)
+        {
+            REQUIRE(bundles.next_index());
+            REQUIRE(bundles.read(readers::chars()) == "0123456789");
+            if(bundles.index() != last_index)
+                ++bundle_count;
+            last_index = bundles.index();
+        }
+        REQUIRE(bundle_count == 2);
+        REQUIRE(bundles.next_index());
+        REQUIRE(bundles.limit() == 1000);
+        REQUIRE(!bundles.next_index());
+    }
+
+    SECTION("Regular excerpts are single messages")
+    {
+        auto appender = chronicle.create_appender();
+        appender.start_excerpt(16);
+        appender.write(7);
+        appender.finish();
+        {
+            bundle_appender bundler(chronicle);
+            bundler.start_excerpt(16);
+            bundler.write(8);
+            bundler.finish();
+            bundler.start_excerpt(16);
+            bundler.write(9);
+            bundler.finish();
+        }
+        appender.start_excerpt(16);
+        appender.finish();
+
+        // Only when asked for
+        bundle_tailer strict(chronicle);
+        REQUIRE_THROWS_AS(strict.next_index(), std::logic_error);
+
+        bundle_tailer bundles(chronicle, bundle_tailer::framing::mixed);
+        for(auto i = 7; i != 10; ++i)
+        {
+            REQUIRE(bundles.next_index());
+            REQUIRE(bundles.read<std::int32_t>() == i);
+        }
+        REQUIRE(bundles.next_index());
+        REQUIRE(bundles.limit() == 0);
+        REQUIRE(!bundles.next_index());
+    }
+}
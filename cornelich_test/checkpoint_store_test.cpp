@@ -0,0 +1,146 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/checkpoint_store.h>
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE_METHOD(clean_up_fixture, "Storing consumer checkpoints", "[checkpoint_store]")
+{
+    SECTION("Named positions")
+    {
+        checkpoint_store store(path().string());
+        REQUIRE(store.load("reader") == -1);
+        REQUIRE(store.min_index() == -1);
+
+        store.store("reader", 100);
+        store.store("writer", 50);
+        store.store("reader", 120);
+        REQUIRE(store.load("reader") == 120);
+        REQUIRE(store.load("writer") == 50);
+        REQUIRE(store.min_index() == 50);
+        store.flush();
+
+        // Seen by another store over the same file (e.g. in another process)
+        checkpoint_store other(path().string());
+        REQUIRE(other.load("reader") == 120);
+        REQUIRE(other.remove("writer"));
+        REQUIRE(!other.remove("writer"));
+        REQUIRE(store.load("writer") == -1);
+        REQUIRE(store.min_index() == 120);
+        other.store("writer", 130);
+        REQUIRE(store.load("writer") == 130);
+
+        REQUIRE_THROWS_AS(store.store("", 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(store.store(std::string(checkpoint_store::MAX_NAME_LENGTH + 1, 'x'), 1), std::invalid_argument);
+        store.store(std::string(checkpoint_store::MAX_NAME_LENGTH, 'x'), 1);
+        REQUIRE(other.load(std::string(checkpoint_store::MAX_NAME_LENGTH, 'x')) == 1);
+        REQUIRE(other.min_index() == 1);
+    }
+
+    SECTION("The store is full")
+    {
+        checkpoint_store store(path().string());
+        for(auto i = 0; i != checkpoint_store::SLOT_COUNT; ++i)
+            store.store("consumer" + std::to_string(i), i);
+        REQUIRE_THROWS_AS(store.store("one more", 1), std::runtime_error);
+        REQUIRE(store.remove("consumer7"));
+        store.store("one more", 1);
+        REQUIRE(store.min_index() == 0);
+    }
+
+    SECTION("A slot reused by another name")
+    {
+        checkpoint_store store(path().string());
+        checkpoint_store other(path().string());
+        store.store("first", 10);
+        REQUIRE(other.remove("first"));
+        // Takes over the freed slot
+        other.store("second", 20);
+        REQUIRE(store.load("first") == -1);
+        REQUIRE(store.load("second") == 20);
+    }
+
+    SECTION("Adding the same name concurrently")
+    {
+        constexpr auto THREAD_COUNT = 4;
+        std::vector<std::unique_ptr<checkpoint_store>> stores;
+        for(auto i = 0; i != THREAD_COUNT; ++i)
+            stores.emplace_back(new checkpoint_store(path().string()));
+        for(auto round = 0; round != 50; ++round)
+        {
+            const auto name = "name" + std::to_string(round);
+            std::vector<std::thread> threads;
+            for(auto i = 0; i != THREAD_COUNT; ++i)
+                threads.emplace_back([&stores, &name, i]() { stores[static_cast<std::size_t>(i)]->store(name, i); });
+            for(auto && t : threads)
+                t.join();
+            // All of them wrote into one slot
+            REQUIRE(stores[0]->remove(name));
+            REQUIRE(stores[0]->load(name) == -1);
+        }
+    }
+
+    SECTION("Resuming a tailer")
+    {
+        vanilla_chronicle_settings settings(path().c_str());
+        {
+            vanilla_chronicle chronicle(settings);
+            auto appender = chronicle.create_appender();
+            for(std::int32_t i = 0; i != 100; ++i)
+            {
+                appender.start_excerpt(4);
+                appender.write(i);
+                appender.finish();
+            }
+
+            auto tailer = chronicle.create_tailer();
+            REQUIRE(!tailer.resume("consumer"));
+            for(auto i = 0; i != 40; ++i)
+                REQUIRE(tailer.next_index());
+            tailer.checkpoint("consumer");
+            chronicle.checkpoints().flush();
+        }
+
+        // After a restart
+        vanilla_chronicle chronicle(settings);
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.resume("consumer"));
+        REQUIRE(tailer.read<std::int32_t>() == 39);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 40);
+        REQUIRE(chronicle.checkpoints().min_index() == tailer.index() - 1);
+
+        // A checkpoint of an excerpt that is gone leaves the tailer where it is
+        chronicle.checkpoints().store("gone", 1);
+        REQUIRE(!tailer.resume("gone"));
+        REQUIRE(tailer.read<std::int32_t>() == 40);
+    }
+}
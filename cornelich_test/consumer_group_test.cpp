@@ -0,0 +1,153 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/consumer_group.h>
+#include <cornelich/region.h>
+#include <cornelich/util/thread.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE_METHOD(clean_up_fixture, "Sharing the excerpts out among a consumer group", "[consumer_group]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    vanilla_chronicle chronicle(settings);
+    auto appender = chronicle.create_appender();
+    auto write = [&appender](std::uint32_t from, std::uint32_t to)
+    {
+        for(auto i = from; i != to; ++i)
+        {
+            appender.start_excerpt(4);
+            appender.write(i);
+            appender.finish();
+        }
+    };
+
+    SECTION("Every excerpt is claimed by exactly one member")
+    {
+        constexpr auto MEMBER_COUNT = 4u;
+        constexpr auto ITER_COUNT = 20000u;
+        write(0, ITER_COUNT / 2);
+
+        std::vector<std::atomic<std::uint32_t>> seen(ITER_COUNT);
+        for(auto && s : seen)
+            s = 0;
+        std::atomic<std::uint32_t> total(0);
+        std::vector<std::uint64_t> claimed(MEMBER_COUNT, 0);
+        std::vector<std::thread> threads;
+        for(auto m = 0u; m != MEMBER_COUNT; ++m)
+        {
+            threads.emplace_back([&, m]()
+            {
+                // A chronicle of its own - as if in another process
+                vanilla_chronicle own(settings);
+                consumer_group member(own, "workers");
+                while(total < ITER_COUNT)
+                {
+                    if(!member.next_index())
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    ++seen[member.tailer().read<std::uint32_t>()];
+                    ++total;
+                }
+                claimed[m] = member.claimed();
+            });
+        }
+        // Keep appending while the group consumes
+        write(ITER_COUNT / 2, ITER_COUNT);
+        for(auto & thread : threads)
+            thread.join();
+
+        REQUIRE(total == ITER_COUNT);
+        std::uint32_t once = 0;
+        for(auto && s : seen)
+            once += (s == 1);
+        REQUIRE(once == ITER_COUNT);
+        std::uint64_t claimed_total = 0;
+        for(auto c : claimed)
+            claimed_total += c;
+        REQUIRE(claimed_total == ITER_COUNT);
+        REQUIRE(fs::exists(fs::path(path()) / "consumer-workers"));
+
+        SECTION("A new member continues where the group is")
+        {
+            consumer_group member(chronicle, "workers");
+            REQUIRE(member.group_index() == chronicle.last_written_index());
+            REQUIRE(!member.next_index());
+            write(0, 1);
+            REQUIRE(member.next_index());
+            REQUIRE(member.index() == chronicle.last_written_index());
+            REQUIRE(!member.next_index());
+        }
+    }
+
+    SECTION("Groups are independent")
+    {
+        write(0, 10);
+        consumer_group first(chronicle, "first");
+        consumer_group late(chronicle, "late", consumer_group::start_position::end);
+        REQUIRE(late.group_index() == chronicle.last_written_index());
+        write(10, 20);
+
+        for(auto i = 0u; i != 20; ++i)
+        {
+            REQUIRE(first.next_index());
+            REQUIRE(first.tailer().read<std::uint32_t>() == i);
+        }
+        REQUIRE(!first.next_index());
+        for(auto i = 10u; i != 20; ++i)
+        {
+            REQUIRE(late.next_index());
+            REQUIRE(late.tailer().read<std::uint32_t>() == i);
+        }
+        REQUIRE(!late.next_index());
+    }
+
+    SECTION("Invalid names")
+    {
+        REQUIRE_THROWS_AS(consumer_group(chronicle, ""), std::invalid_argument);
+        REQUIRE_THROWS_AS(consumer_group(chronicle, "a/b"), std::invalid_argument);
+    }
+
+    SECTION("The initializer died")
+    {
+        write(0, 3);
+        {
+            // Stuck initializing by a process that is gone (no pid reaches pid_max)
+            region file(settings.path() + "/" + CONSUMER_FILE_NAME_PREFIX + "dead", 64, 0);
+            file.write_ordered64(0, (static_cast<std::int64_t>(util::native_thread_id_limit()) << 2) | 1);
+        }
+        consumer_group group(chronicle, "dead");
+        REQUIRE(group.group_index() == -1);
+        REQUIRE(group.next_index());
+        REQUIRE(group.tailer().read<std::uint32_t>() == 0);
+    }
+}
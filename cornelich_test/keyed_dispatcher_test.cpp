@@ -0,0 +1,130 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/keyed_dispatcher.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+std::uint32_t read_uint32(const excerpt_view & view, std::int32_t offset)
+{
+    std::uint32_t result;
+    std::memcpy(&result, view.data + offset, 4);
+    return result;
+}
+
+void wait_until_handled(const keyed_dispatcher & dispatcher, std::uint64_t count)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while(dispatcher.handled() < count && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Dispatching excerpts to workers by key", "[keyed_dispatcher]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // Small data files - the workers have to keep several of them mapped
+    settings.data_block_size(1ULL << 16);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto KEY_COUNT = 16u;
+    constexpr auto WORKER_COUNT = 4u;
+    constexpr auto ITER_COUNT = 20000u;
+    auto appender = chronicle.create_appender();
+    // (key, sequence within the key)
+    auto write = [&appender](std::uint32_t from, std::uint32_t to)
+    {
+        for(auto i = from; i != to; ++i)
+        {
+            appender.start_excerpt(8);
+            appender.write(i % KEY_COUNT);
+            appender.write(i / KEY_COUNT);
+            appender.finish();
+        }
+    };
+    auto key_of = [](const excerpt_view & view) { return static_cast<std::uint64_t>(read_uint32(view, 0)); };
+
+    SECTION("Excerpts of a key are handled in order by one worker")
+    {
+        write(0, ITER_COUNT / 2);
+
+        // Only the worker owning a key touches its slot
+        std::vector<std::uint32_t> next_sequence(KEY_COUNT, 0);
+        std::vector<std::size_t> key_workers(KEY_COUNT, WORKER_COUNT);
+        std::atomic<std::uint32_t> errors(0);
+        auto tailer = chronicle.create_tailer();
+        tailer.to_start();
+        keyed_dispatcher dispatcher(std::move(tailer), WORKER_COUNT, key_of, [&](std::size_t worker, const excerpt_view & view)
+        {
+            const auto key = read_uint32(view, 0);
+            if(view.length != 8 || worker != dispatcher.worker_for(key) || read_uint32(view, 4) != next_sequence[key]++)
+                ++errors;
+            key_workers[key] = worker;
+        }, 64, 100);
+
+        // Keep appending while the dispatcher runs
+        write(ITER_COUNT / 2, ITER_COUNT);
+        wait_until_handled(dispatcher, ITER_COUNT);
+        dispatcher.stop();
+
+        REQUIRE(dispatcher.handled() == ITER_COUNT);
+        REQUIRE(dispatcher.dispatched() == ITER_COUNT);
+        REQUIRE(dispatcher.last_dispatched_index() == chronicle.last_written_index());
+        REQUIRE(errors == 0);
+        for(auto key = 0u; key != KEY_COUNT; ++key)
+        {
+            REQUIRE(next_sequence[key] == ITER_COUNT / KEY_COUNT);
+            REQUIRE(key_workers[key] == dispatcher.worker_for(key));
+        }
+    }
+
+    SECTION("A handler exception stops the dispatching")
+    {
+        write(0, 1000);
+        std::atomic<std::uint32_t> count(0);
+        auto tailer = chronicle.create_tailer();
+        keyed_dispatcher dispatcher(std::move(tailer), WORKER_COUNT, key_of, [&](std::size_t, const excerpt_view & view)
+        {
+            ++count;
+            if(read_uint32(view, 4) == 10)
+                throw std::runtime_error("Failed");
+        });
+        wait_until_handled(dispatcher, 1000);
+        REQUIRE_THROWS_AS(dispatcher.stop(), std::runtime_error);
+        REQUIRE(count < 1000);
+    }
+
+    REQUIRE_THROWS_AS(keyed_dispatcher(chronicle.create_tailer(), 0, key_of, [](std::size_t, const excerpt_view &) {}), std::invalid_argument);
+}
@@ -0,0 +1,149 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/merge_tailer.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+std::int64_t timestamp_of(const excerpt_view & view)
+{
+    std::int64_t result;
+    std::memcpy(&result, view.data, 8);
+    return result;
+}
+
+void write(vanilla_chronicle & chronicle, std::int64_t timestamp, std::int32_t source)
+{
+    auto appender = chronicle.create_appender();
+    appender.start_excerpt(12);
+    appender.write(timestamp);
+    appender.write(source);
+    appender.finish();
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Merging chronicles by timestamp", "[merge_tailer]")
+{
+    constexpr auto SOURCE_COUNT = 3;
+    std::vector<std::unique_ptr<vanilla_chronicle>> chronicles;
+    std::vector<excerpt_tailer> tailers;
+    for(auto i = 0; i != SOURCE_COUNT; ++i)
+    {
+        chronicles.emplace_back(new vanilla_chronicle(vanilla_chronicle_settings((path() / std::to_string(i)).string())));
+        tailers.push_back(chronicles.back()->create_tailer());
+    }
+    REQUIRE_THROWS_AS(merge_tailer({}, timestamp_of), std::invalid_argument);
+
+    SECTION("The excerpts come in timestamp order")
+    {
+        // Sources of different pace, some timestamps equal
+        constexpr auto ITER_COUNT = 3000;
+        std::int64_t expected = 0;
+        for(auto i = 0; i != SOURCE_COUNT; ++i)
+        {
+            for(std::int64_t t = 0; t < ITER_COUNT; t += i + 1)
+            {
+                write(*chronicles[i], t, i);
+                ++expected;
+            }
+        }
+
+        merge_tailer merge(std::move(tailers), timestamp_of, 100);
+        REQUIRE(merge.source_count() == SOURCE_COUNT);
+        std::int64_t count = 0;
+        std::int64_t last_timestamp = -1;
+        std::size_t last_source = 0;
+        while(merge.next())
+        {
+            REQUIRE(merge.timestamp() == timestamp_of(merge.current()));
+            REQUIRE(merge.timestamp() >= last_timestamp);
+            if(merge.timestamp() == last_timestamp)
+                REQUIRE(merge.source() > last_source);
+            std::int32_t source;
+            std::memcpy(&source, merge.current().data + 8, 4);
+            REQUIRE(static_cast<std::size_t>(source) == merge.source());
+            REQUIRE(merge.current().index <= merge.tailer(merge.source()).index());
+            last_timestamp = merge.timestamp();
+            last_source = merge.source();
+            ++count;
+        }
+        REQUIRE(count == expected);
+
+        // More data later
+        write(*chronicles[1], ITER_COUNT + 1, 1);
+        write(*chronicles[0], ITER_COUNT, 0);
+        REQUIRE(merge.next());
+        REQUIRE(merge.timestamp() == ITER_COUNT);
+        REQUIRE(merge.next());
+        REQUIRE(merge.timestamp() == ITER_COUNT + 1);
+        REQUIRE(!merge.next());
+    }
+
+    SECTION("The live mode waits for lagging sources")
+    {
+        write(*chronicles[0], 10, 0);
+        write(*chronicles[1], 20, 1);
+        merge_tailer merge(std::move(tailers), timestamp_of);
+        merge.live(50000);
+
+        // Source 2 has nothing yet
+        REQUIRE(!merge.next());
+        write(*chronicles[2], 5, 2);
+        REQUIRE(merge.next());
+        REQUIRE(merge.source() == 2);
+
+        // Source 2 lags again - the merge moves on once the wait is over
+        REQUIRE(!merge.next());
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        REQUIRE(merge.next());
+        REQUIRE(merge.source() == 0);
+        // Source 2 has been waited for already, source 0 has just run out
+        REQUIRE(!merge.next());
+        write(*chronicles[0], 15, 0);
+        REQUIRE(merge.next());
+        REQUIRE(merge.source() == 0);
+        REQUIRE(!merge.next());
+        std::this_thread::sleep_for(std::chrono::milliseconds(60));
+        REQUIRE(merge.next());
+        REQUIRE(merge.source() == 1);
+        REQUIRE(!merge.next());
+
+        // Without the live mode the merge does not wait
+        write(*chronicles[1], 30, 1);
+        merge.live(0);
+        REQUIRE(merge.next());
+        REQUIRE(merge.timestamp() == 30);
+    }
+}
@@ -0,0 +1,128 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/mpsc_ring.h>
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE( "util::mpsc_ring", "[util/mpsc_ring]")
+{
+    SECTION("Invalid parameters")
+    {
+        REQUIRE_THROWS_AS(util::mpsc_ring(0, 8), std::invalid_argument);
+        REQUIRE_THROWS_AS(util::mpsc_ring(3, 8), std::invalid_argument);
+        REQUIRE_THROWS_AS(util::mpsc_ring(4, 0), std::invalid_argument);
+    }
+
+    GIVEN("An empty ring")
+    {
+        util::mpsc_ring ring(4, 16);
+        REQUIRE(ring.capacity() == 4);
+        REQUIRE(ring.slot_size() == 16);
+
+        std::uint64_t seq = 0;
+        std::int32_t len = 0;
+        REQUIRE(ring.peek(seq, len) == nullptr);
+
+        SECTION("Claimed but unpublished slots are not visible")
+        {
+            auto * p = ring.claim(seq);
+            REQUIRE(p != nullptr);
+            REQUIRE(seq == 0);
+            REQUIRE(ring.peek(seq, len) == nullptr);
+            std::memcpy(p, "abc", 3);
+            ring.publish(0, 3);
+            auto * c = ring.peek(seq, len);
+            REQUIRE(c != nullptr);
+            REQUIRE(seq == 0);
+            REQUIRE(len == 3);
+            REQUIRE(std::memcmp(c, "abc", 3) == 0);
+            ring.pop();
+            REQUIRE(ring.peek(seq, len) == nullptr);
+            REQUIRE(ring.consumed() == 1);
+        }
+
+        SECTION("A full ring refuses claims until the consumer catches up")
+        {
+            for(std::uint64_t i = 0; i != 4; ++i)
+            {
+                REQUIRE(ring.claim(seq) != nullptr);
+                REQUIRE(seq == i);
+                ring.publish(seq, 0);
+            }
+            REQUIRE(ring.claim(seq) == nullptr);
+            REQUIRE(ring.peek(seq, len) != nullptr);
+            ring.pop();
+            REQUIRE(ring.claim(seq) != nullptr);
+            REQUIRE(seq == 4);
+            REQUIRE(ring.claimed() == 5);
+        }
+    }
+
+    GIVEN("Multiple producers")
+    {
+        constexpr auto THREAD_COUNT = 4u;
+        constexpr auto ITER_COUNT = 20000u;
+        util::mpsc_ring ring(64, 8);
+        std::vector<std::thread> threads;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+        {
+            threads.push_back(std::thread([&ring, tid]()
+            {
+                for(auto i = 0u; i != ITER_COUNT; ++i)
+                {
+                    std::uint64_t seq;
+                    std::uint8_t * p;
+                    while(!(p = ring.claim(seq)))
+                        std::this_thread::yield();
+                    std::memcpy(p, &tid, 4);
+                    std::memcpy(p + 4, &i, 4);
+                    ring.publish(seq, 8);
+                }
+            }));
+        }
+
+        std::vector<std::uint32_t> counts(THREAD_COUNT, 0);
+        for(auto n = 0u; n != THREAD_COUNT * ITER_COUNT;)
+        {
+            std::uint64_t seq;
+            std::int32_t len;
+            auto * p = ring.peek(seq, len);
+            if(!p)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            REQUIRE(seq == n);
+            REQUIRE(len == 8);
+            std::uint32_t tid, i;
+            std::memcpy(&tid, p, 4);
+            std::memcpy(&i, p + 4, 4);
+            REQUIRE(counts[tid]++ == i);
+            ring.pop();
+            ++n;
+        }
+        for(auto & thread : threads)
+            thread.join();
+    }
+}
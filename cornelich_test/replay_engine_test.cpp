@@ -0,0 +1,144 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/replay_engine.h>
+
+#include "write_test_data.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+std::pair<std::uint32_t, std::uint32_t> id_and_sequence(const excerpt_view & view)
+{
+    std::pair<std::uint32_t, std::uint32_t> result;
+    std::memcpy(&result.first, view.data, 4);
+    std::memcpy(&result.second, view.data + 4, 4);
+    return result;
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Replaying a chronicle on several threads", "[replay_engine]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto ITER_COUNT = 3000u;
+    {
+        std::vector<std::thread> threads;
+        for(auto tid = 0u; tid != 2; ++tid)
+        {
+            threads.emplace_back([&chronicle, tid]()
+            {
+                auto appender = chronicle.create_appender();
+                write_test_data(appender, tid, ITER_COUNT);
+            });
+        }
+        for(auto & thread : threads)
+            thread.join();
+    }
+
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(tailer.to_start().next_index());
+    const auto first = tailer.index();
+    const auto end = chronicle.last_written_index() + 1;
+    REQUIRE(end == first + 2 * ITER_COUNT);
+
+    replay_engine engine(chronicle, 4);
+    REQUIRE_THROWS_AS(replay_engine(chronicle, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(replay_engine(chronicle, 4, 0), std::invalid_argument);
+
+    SECTION("Unordered replay delivers every excerpt once")
+    {
+        std::mutex lock;
+        std::set<std::pair<std::uint32_t, std::uint32_t>> seen;
+        const auto count = engine.for_each(first, end, [&](const excerpt_view & view)
+        {
+            std::lock_guard<std::mutex> lk(lock);
+            REQUIRE(seen.insert(id_and_sequence(view)).second);
+        });
+        REQUIRE(count == 2 * ITER_COUNT);
+        REQUIRE(seen.size() == 2 * ITER_COUNT);
+    }
+
+    SECTION("Ordered replay delivers the excerpts in index order")
+    {
+        // Blocks of whole index files and blocks cut within them
+        replay_engine small_blocks(chronicle, 4, 100);
+        for(auto * replay : {&engine, &small_blocks})
+        {
+            std::vector<std::uint32_t> next_sequence(2, 0);
+            auto expected_index = first + 100;
+            const auto count = replay->for_each_ordered(first + 100, end - 100, [&](const excerpt_view & view)
+            {
+                REQUIRE(view.index == expected_index);
+                ++expected_index;
+                const auto id = id_and_sequence(view);
+                // Every writer's excerpts are in its own order
+                if(id.second < next_sequence[id.first])
+                    FAIL("Out of order excerpt of writer " << id.first);
+                next_sequence[id.first] = id.second + 1;
+            });
+            REQUIRE(count == 2 * ITER_COUNT - 200);
+            REQUIRE(expected_index == end - 100);
+        }
+    }
+
+    SECTION("Replaying a whole cycle")
+    {
+        std::atomic<std::size_t> count(0);
+        const auto cycle = static_cast<std::int32_t>(first / (chronicle.entries_for_cycle_mask() + 1));
+        REQUIRE(engine.for_each_in_cycle(cycle, [&](const excerpt_view &) { ++count; }) == 2 * ITER_COUNT);
+        REQUIRE(count == 2 * ITER_COUNT);
+        REQUIRE(engine.for_each_in_cycle_ordered(cycle + 1, [&](const excerpt_view &) { ++count; }) == 0);
+        REQUIRE(engine.for_each(end, end + 10, [&](const excerpt_view &) { ++count; }) == 0);
+    }
+
+    SECTION("A handler exception stops the replay")
+    {
+        std::atomic<std::size_t> count(0);
+        auto failing = [&](const excerpt_view &)
+        {
+            if(++count == 1500)
+                throw std::runtime_error("Enough");
+        };
+        REQUIRE_THROWS_AS(engine.for_each(first, end, failing), std::runtime_error);
+        count = 0;
+        REQUIRE_THROWS_AS(engine.for_each_ordered(first, end, failing), std::runtime_error);
+        REQUIRE(count == 1500);
+    }
+}
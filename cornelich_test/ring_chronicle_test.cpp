@@ -0,0 +1,195 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cornelich/util/test_helpers.h>
+#include <cornelich/util/stop_bit.h>
+
+#include <cornelich/ring_chronicle.h>
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+void write_excerpts(ring_appender & appender, std::int64_t first, std::int64_t count)
+{
+    for(auto i = first; i != first + count; ++i)
+    {
+        appender.start_excerpt(32);
+        appender.write(i);
+        appender.write(static_cast<std::uint64_t>(i), util::stop_bit::write);
+        appender.finish();
+    }
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Ring chronicle", "[ring_chronicle]")
+{
+    const auto file = (path() / "ring").string();
+
+    SECTION("Writing and reading")
+    {
+        ring_chronicle chronicle(file, 16, 32);
+        REQUIRE(chronicle.last_index() == -1);
+
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(!tailer.next_index());
+
+        auto appender = chronicle.create_appender();
+        write_excerpts(appender, 0, 10);
+        REQUIRE(appender.last_written_index() == 9);
+        REQUIRE(chronicle.last_index() == 9);
+
+        for(std::int64_t i = 0; i != 10; ++i)
+        {
+            REQUIRE(tailer.next_index());
+            REQUIRE(tailer.index() == i);
+            REQUIRE(tailer.read<std::int64_t>() == i);
+            REQUIRE(tailer.read(util::stop_bit::read) == static_cast<std::uint64_t>(i));
+            REQUIRE(tailer.valid());
+        }
+        REQUIRE(!tailer.next_index());
+        REQUIRE(tailer.lost() == 0);
+
+        // Another mapping of the same ring (e.g. in another process)
+        ring_chronicle other(file, 16, 32);
+        REQUIRE(other.last_index() == 9);
+        auto other_tailer = other.create_tailer();
+        REQUIRE(other_tailer.next_index());
+        REQUIRE(other_tailer.index() == 0);
+        other_tailer.to_end();
+        REQUIRE(!other_tailer.next_index());
+        write_excerpts(appender, 10, 1);
+        REQUIRE(other_tailer.next_index());
+        REQUIRE(other_tailer.read<std::int64_t>() == 10);
+    }
+
+    SECTION("Overwritten excerpts")
+    {
+        ring_chronicle chronicle(file, 8, 32);
+        auto tailer = chronicle.create_tailer();
+        auto appender = chronicle.create_appender();
+
+        write_excerpts(appender, 0, 3);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == 0);
+
+        // Lap the tailer - the excerpt it is looking at and 1 to 3 are overwritten
+        write_excerpts(appender, 3, 9);
+        REQUIRE(!tailer.valid());
+
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == 4);
+        REQUIRE(tailer.read<std::int64_t>() == 4);
+        REQUIRE(tailer.lost() == 3);
+
+        auto late = chronicle.create_tailer();
+        REQUIRE(late.next_index());
+        REQUIRE(late.index() == 4);
+        REQUIRE(late.lost() == 0);
+    }
+
+    SECTION("A dead appender")
+    {
+        ring_chronicle chronicle(file, 4, 32);
+        auto tailer = chronicle.create_tailer();
+
+        // Claims index 0 and never finishes it
+        auto dead = chronicle.create_appender();
+        dead.start_excerpt(32);
+        dead.write(std::int64_t(-1));
+
+        auto appender = chronicle.create_appender();
+        write_excerpts(appender, 1, 3);
+        REQUIRE(!tailer.next_index());
+
+        // The next lap takes the slot over once the stall timeout has passed
+        appender.start_excerpt(32, 1000);
+        appender.write(std::int64_t(4));
+        appender.finish();
+        REQUIRE(appender.last_written_index() == 4);
+
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == 1);
+        REQUIRE(tailer.lost() == 1);
+
+        REQUIRE_THROWS_AS(dead.finish(), std::runtime_error);
+        REQUIRE(dead.last_written_index() == -1);
+        REQUIRE_THROWS_AS(dead.finish(), std::logic_error);
+    }
+
+    SECTION("Invalid geometry")
+    {
+        REQUIRE_THROWS_AS(ring_chronicle(file, 12, 64), std::invalid_argument);
+        REQUIRE_THROWS_AS(ring_chronicle(file, 16, 0), std::invalid_argument);
+
+        ring_chronicle chronicle(file, 16, 32);
+        REQUIRE_THROWS_AS(ring_chronicle(file, 32, 32), std::invalid_argument);
+
+        auto appender = chronicle.create_appender();
+        REQUIRE_THROWS_AS(appender.start_excerpt(33), std::invalid_argument);
+        REQUIRE_THROWS_AS(appender.finish(), std::logic_error);
+    }
+
+    SECTION("Concurrent appenders")
+    {
+        const std::int64_t count = 20000;
+        const auto writers = 4;
+        ring_chronicle chronicle(file, 1 << 17, 32);
+
+        std::vector<std::thread> threads;
+        for(auto w = 0; w != writers; ++w)
+        {
+            threads.emplace_back([&chronicle, w, count]()
+            {
+                auto appender = chronicle.create_appender();
+                write_excerpts(appender, w * count, count);
+            });
+        }
+
+        auto tailer = chronicle.create_tailer();
+        std::vector<std::int64_t> next(writers, 0);
+        std::int64_t read = 0;
+        while(read != count * writers)
+        {
+            if(!tailer.next_index())
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            const auto value = tailer.read<std::int64_t>();
+            const auto writer = value / count;
+            const auto sequence = value % count;
+            // Each writer's excerpts come in the order they were written
+            REQUIRE(sequence == next[writer]);
+            ++next[writer];
+            ++read;
+        }
+        for(auto & t : threads)
+            t.join();
+        REQUIRE(tailer.lost() == 0);
+        REQUIRE(!tailer.next_index());
+    }
+}
@@ -0,0 +1,95 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include <cornelich/util/spsc_queue.h>
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+TEST_CASE( "util::spsc_queue", "[util/spsc_queue]")
+{
+    SECTION("Invalid parameters")
+    {
+        REQUIRE_THROWS_AS(util::spsc_queue<int>(0), std::invalid_argument);
+        REQUIRE_THROWS_AS(util::spsc_queue<int>(6), std::invalid_argument);
+    }
+
+    GIVEN("An empty queue")
+    {
+        util::spsc_queue<std::unique_ptr<int>> queue(4);
+        REQUIRE(queue.capacity() == 4);
+        REQUIRE(queue.empty());
+        REQUIRE(queue.front() == nullptr);
+
+        SECTION("A full queue refuses elements until the consumer catches up")
+        {
+            for(auto i = 0; i != 4; ++i)
+                REQUIRE(queue.try_push(std::unique_ptr<int>(new int(i))));
+            std::unique_ptr<int> extra(new int(4));
+            REQUIRE(!queue.try_push(std::move(extra)));
+            // Not moved from on failure
+            REQUIRE(extra);
+
+            auto * first = queue.front();
+            REQUIRE(first != nullptr);
+            REQUIRE(**first == 0);
+            // front() does not consume
+            REQUIRE(queue.front() == first);
+            queue.pop();
+            REQUIRE(queue.try_push(std::move(extra)));
+            for(auto i = 1; i != 5; ++i)
+            {
+                REQUIRE(**queue.front() == i);
+                queue.pop();
+            }
+            REQUIRE(queue.empty());
+        }
+    }
+
+    GIVEN("A producer and a consumer")
+    {
+        constexpr auto ITER_COUNT = 200000u;
+        util::spsc_queue<std::uint32_t> queue(64);
+        std::thread producer([&queue]()
+        {
+            for(auto i = 0u; i != ITER_COUNT; ++i)
+            {
+                while(!queue.try_push(i))
+                    std::this_thread::yield();
+            }
+        });
+
+        for(auto i = 0u; i != ITER_COUNT;)
+        {
+            auto * value = queue.front();
+            if(!value)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            REQUIRE(*value == i);
+            queue.pop();
+            ++i;
+        }
+        producer.join();
+        REQUIRE(queue.empty());
+    }
+}
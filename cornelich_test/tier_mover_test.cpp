@@ -0,0 +1,177 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+#include "write_test_data.h"
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_chronicle.h>
+#include <cornelich/vanilla_date.h>
+#include <cornelich/vanilla_utils.h>
+#include <cornelich/tier_mover.h>
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+/// The cycles of the excerpts found by a new tailer and their number
+std::vector<std::int64_t> read_cycles(vanilla_chronicle & chronicle, std::uint32_t & count)
+{
+    auto tailer = chronicle.create_tailer();
+    std::vector<std::int64_t> cycles;
+    count = 0;
+    while(tailer.next_index())
+    {
+        const auto cycle = tailer.index() / chronicle.settings().entries_per_cycle();
+        if(cycles.empty() || cycles.back() != cycle)
+            cycles.push_back(cycle);
+        if(tailer.read<std::uint32_t>() != 1)
+            throw std::logic_error("Unexpected excerpt");
+        ++count;
+    }
+    return cycles;
+}
+
+/// Number of bytes the file takes on the disk
+std::uint64_t allocated(const fs::path & file)
+{
+    struct stat st;
+    if(::stat(file.c_str(), &st) != 0)
+        throw std::runtime_error("stat " + file.string());
+    return static_cast<std::uint64_t>(st.st_blocks) * 512;
+}
+
+/// Copy the files of a cycle to another cycle
+void copy_cycle(const fs::path & base, const vanilla_chronicle_settings & settings, std::int32_t from, std::int32_t to)
+{
+    const auto from_path = base / settings.cycle_format().date_from_cycle(from);
+    const auto to_path = base / settings.cycle_format().date_from_cycle(to);
+    fs::create_directories(to_path);
+    for(fs::directory_iterator it(from_path), end; it != end; ++it)
+        fs::copy_file(it->path(), to_path / it->path().filename());
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Moving closed cycles to the base path", "[tier_mover]")
+{
+    const auto active = path() / "active";
+    const auto durable = path() / "durable";
+    vanilla_chronicle_settings settings(durable.string());
+    settings.active_path(active.string());
+
+    REQUIRE_THROWS_AS(tier_mover(vanilla_chronicle_settings(durable.string())), std::invalid_argument);
+    REQUIRE_THROWS_AS(tier_mover(settings, 1), std::invalid_argument);
+
+    constexpr auto ITER_COUNT = 100u;
+    vanilla_chronicle chronicle(settings);
+    {
+        auto appender = chronicle.create_appender();
+        write_test_data(appender, 1, ITER_COUNT);
+    }
+
+    const auto today = cycle_for_now(settings.cycle_length());
+    const auto today_string = settings.cycle_format().date_from_cycle(today);
+    REQUIRE(fs::exists(active / today_string));
+    REQUIRE(!fs::exists(durable / today_string));
+
+    // Closed cycles - a year and a month ago
+    copy_cycle(active, settings, today, today - 400);
+    copy_cycle(active, settings, today, today - 30);
+    // A sparse file - only its data gets copied
+    const auto sparse_name = settings.cycle_format().date_from_cycle(today - 30) + "/sparse";
+    {
+        std::ofstream sparse((active / sparse_name).string(), std::ios::binary);
+        sparse.seekp(1 << 20);
+        sparse << "tail";
+    }
+    const auto sparse_size = fs::file_size(active / sparse_name);
+    const auto files = std::distance(fs::directory_iterator(active / today_string), fs::directory_iterator());
+    const std::vector<std::int64_t> all_cycles{today - 400, today - 30, today};
+
+    std::uint32_t count = 0;
+    REQUIRE(read_cycles(chronicle, count) == all_cycles);
+    REQUIRE(count == 3 * ITER_COUNT);
+
+    tier_mover mover(settings);
+    REQUIRE(mover.move_closed() == static_cast<std::size_t>(2 * files + 1));
+    REQUIRE(mover.moved() == static_cast<std::uint64_t>(2 * files + 1));
+    REQUIRE(fs::file_size(durable / sparse_name) == sparse_size);
+    REQUIRE(allocated(durable / sparse_name) <= allocated(active / sparse_name));
+    {
+        std::ifstream sparse((durable / sparse_name).string(), std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(sparse)), std::istreambuf_iterator<char>());
+        REQUIRE(content == std::string(1 << 20, '\0') + "tail");
+    }
+    for(auto cycle : {today - 400, today - 30})
+    {
+        const auto cycle_string = settings.cycle_format().date_from_cycle(cycle);
+        REQUIRE(fs::exists(durable / cycle_string / (INDEX_FILE_NAME_PREFIX + "0")));
+        // Left for the readers which might have just found it
+        REQUIRE(fs::exists(active / cycle_string / (INDEX_FILE_NAME_PREFIX + "0")));
+    }
+    REQUIRE(!fs::exists(durable / today_string));
+
+    // The second pass removes the moved files from the active tier
+    REQUIRE(mover.move_closed() == 0);
+    REQUIRE(!fs::exists(active / settings.cycle_format().date_from_cycle(today - 400)));
+    REQUIRE(!fs::exists(active / settings.cycle_format().date_from_cycle(today - 30)));
+    REQUIRE(fs::exists(active / today_string));
+
+    // Neither the chronicle which has seen the files in the active tier nor a new one notices the move
+    REQUIRE(read_cycles(chronicle, count) == all_cycles);
+    REQUIRE(count == 3 * ITER_COUNT);
+    vanilla_chronicle reopened(settings);
+    REQUIRE(read_cycles(reopened, count) == all_cycles);
+    REQUIRE(count == 3 * ITER_COUNT);
+
+    {
+        auto appender = reopened.create_appender();
+        write_test_data(appender, 1, ITER_COUNT);
+    }
+    REQUIRE(!fs::exists(durable / today_string));
+    REQUIRE(read_cycles(chronicle, count) == all_cycles);
+    REQUIRE(count == 4 * ITER_COUNT);
+
+    SECTION("In the background")
+    {
+        copy_cycle(active, settings, today, today - 10);
+        mover.start(std::chrono::milliseconds(1));
+        const auto moved_file = durable / settings.cycle_format().date_from_cycle(today - 10) / (INDEX_FILE_NAME_PREFIX + "0");
+        for(auto i = 0; i != 5000 && !fs::exists(moved_file); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        mover.stop();
+        REQUIRE(fs::exists(moved_file));
+        REQUIRE(read_cycles(chronicle, count).size() == 4);
+        // Today's cycle had twice as many excerpts when copied
+        REQUIRE(count == 6 * ITER_COUNT);
+    }
+}
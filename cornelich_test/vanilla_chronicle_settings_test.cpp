@@ -41,6 +41,9 @@ TEST_CASE( "Default settings are set", "[vanilla_chronicle_settings]" )
         REQUIRE(settings.thread_id_mask() == 0xFFFF);
         REQUIRE(settings.index_data_offset_bits() == 48);
         REQUIRE(settings.index_data_offset_mask() == 0xFFFFFFFFFFFFLL);
+        REQUIRE(settings.time_index_interval() == 0);
+        REQUIRE(!settings.shared_header());
+        REQUIRE(settings.active_path().empty());
 
     }
 }
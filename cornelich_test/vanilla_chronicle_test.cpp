@@ -22,16 +22,24 @@ limitations under the License.
 #include <cornelich/vanilla_chronicle_settings.h>
 #include <cornelich/vanilla_chronicle.h>
 #include <cornelich/vanilla_date.h>
+#include <cornelich/vanilla_utils.h>
 #include <cornelich/formatters.h>
+#include <cornelich/util/thread.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <limits>
 #include <chrono>
+#include <fstream>
 #include <thread>
 #include <vector>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include <catch.hpp>
 
 
@@ -152,8 +160,11 @@ TEST_CASE_METHOD(clean_up_fixture, "Using excerpt_appender to write data into th
 
             int idx = 0;
             auto tailer = chronicle.create_tailer();
-            while(!done)
+            bool writer_done = false;
+            do
             {
+                // Drain once more after the writer is done - it may finish before we read anything
+                writer_done = done;
                 while(tailer.next_index())
                 {
                     REQUIRE(tailer.limit()==36);
@@ -161,9 +172,9 @@ TEST_CASE_METHOD(clean_up_fixture, "Using excerpt_appender to write data into th
                     REQUIRE(tailer.read<std::int32_t>() == idx);
                     ++idx;
                 }
-            }
-            REQUIRE(idx == 1000);
+            } while(!writer_done);
             t.join();
+            REQUIRE(idx == 1000);
         }
 
         SECTION("Can write with multiple writers")
@@ -198,3 +209,1119 @@ TEST_CASE_METHOD(clean_up_fixture, "Using excerpt_appender to write data into th
     }
 }
 
+TEST_CASE_METHOD(clean_up_fixture, "Appenders continue writing into the last data file", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 20);
+    settings.index_block_size(1ULL << 13);
+
+    auto count_data_files = [this]()
+    {
+        auto count = 0;
+        for(fs::recursive_directory_iterator it(path()), end; it != end; ++it)
+        {
+            if(fs::is_regular_file(*it) && it->path().filename().string().compare(0, DATA_FILE_NAME_PREFIX.size(), DATA_FILE_NAME_PREFIX) == 0)
+                ++count;
+        }
+        return count;
+    };
+
+    SECTION("After a restart")
+    {
+        // A restarted process has other native thread ids - only a fixed writer id finds its files again
+        const auto WRITER_ID = test_writer_id(vanilla_chronicle(settings), 42);
+        {
+            vanilla_chronicle chronicle(settings);
+            auto appender = chronicle.create_appender(WRITER_ID);
+            write_test_data(appender, 0, 1000);
+        }
+        {
+            vanilla_chronicle chronicle(settings);
+            auto appender = chronicle.create_appender(WRITER_ID);
+            write_test_data(appender, 1, 1000);
+        }
+        REQUIRE(count_data_files() == 1);
+
+        vanilla_chronicle chronicle(settings);
+        auto tailer = chronicle.create_tailer();
+        for(int id = 0; id != 2; ++id)
+        {
+            for(int i = 0; i != 1000; ++i)
+            {
+                REQUIRE(tailer.next_index());
+                REQUIRE(tailer.limit()==36);
+                REQUIRE(tailer.read<std::int32_t>() == id);
+                REQUIRE(tailer.read<std::int32_t>() == i);
+            }
+        }
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("With an appender per request")
+    {
+        vanilla_chronicle chronicle(settings);
+        for(int i = 0; i != 100; ++i)
+        {
+            auto appender = chronicle.create_appender();
+            write_test_data(appender, 0, 1);
+        }
+        REQUIRE(count_data_files() == 1);
+    }
+
+    SECTION("Appenders of one thread")
+    {
+        vanilla_chronicle chronicle(settings);
+        auto first = chronicle.create_appender();
+        auto second = chronicle.create_appender();
+        // Both excerpts open at once - they must not share the data file
+        first.start_excerpt(64);
+        second.start_excerpt(64);
+        first.write(std::int32_t(1));
+        second.write(std::int32_t(2));
+        second.finish();
+        first.finish();
+        REQUIRE(count_data_files() == 2);
+
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 2);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 1);
+
+        // Each one keeps its own file and position
+        write_test_data(first, 1, 10);
+        write_test_data(second, 2, 10);
+        REQUIRE(count_data_files() == 2);
+        for(int i = 0; i != 20; ++i)
+        {
+            REQUIRE(tailer.next_index());
+            const auto id = tailer.read<std::int32_t>();
+            const auto value = tailer.read<std::int32_t>();
+            REQUIRE(id == (i < 10 ? 1 : 2));
+            REQUIRE(value == i % 10);
+        }
+    }
+
+    SECTION("Finding the end of the committed data")
+    {
+        vanilla_chronicle chronicle(settings);
+        auto appender = chronicle.create_appender();
+        write_test_data(appender, 0, 3);
+        // 3 * (4 bytes length + 36 bytes of data)
+        region r((path() / fs::directory_iterator(path())->path().filename() /
+                  (DATA_FILE_NAME_PREFIX + std::to_string(util::get_native_thread_id()) + "-0")).string(), 1 << 20, 0);
+        REQUIRE(vanilla_data::find_data_end(r, 0) == 120);
+        REQUIRE(vanilla_data::find_data_end(r, 40) == 120);
+        REQUIRE(vanilla_data::find_data_end(r, 120) == 120);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reserving excerpts and committing them out of order", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.data_block_size(1ULL << 20);
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+    auto appender = chronicle.create_appender();
+
+    SECTION("Reservations are independent")
+    {
+        auto first = appender.reserve(64);
+        auto second = appender.reserve(64);
+        REQUIRE(first.pending());
+        REQUIRE(first.index() == -1);
+        REQUIRE((second.buffer().data() - first.buffer().data()) == 68);
+
+        second.write(2);
+        first.write(1);
+        first.write(11);
+        REQUIRE(appender.commit(second) >= 0);
+        REQUIRE(!second.pending());
+        REQUIRE_THROWS_AS(appender.commit(second), std::logic_error);
+
+        // Regular excerpts can be mixed with reservations
+        appender.start_excerpt(64);
+        appender.write(3);
+        REQUIRE_THROWS_AS(appender.reserve(64), std::logic_error);
+        appender.finish();
+
+        REQUIRE(appender.commit(first) == second.index() + 2);
+
+        auto tailer = chronicle.create_tailer();
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == second.index());
+        REQUIRE(tailer.limit() == 4);
+        REQUIRE(tailer.read<std::int32_t>() == 2);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 3);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.limit() == 8);
+        REQUIRE(tailer.read<std::int32_t>() == 1);
+        REQUIRE(tailer.read<std::int32_t>() == 11);
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("Overflowing a reservation")
+    {
+        auto r = appender.reserve(4);
+        r.write(1LL);
+        REQUIRE_THROWS_AS(appender.commit(r), std::logic_error);
+    }
+
+    SECTION("Filled on different threads")
+    {
+        constexpr auto COUNT = 100;
+        std::vector<excerpt_reservation> reservations;
+        for(int i = 0; i != COUNT; ++i)
+            reservations.push_back(appender.reserve(32));
+
+        std::thread t([&reservations]()
+        {
+            for(int i = 0; i < COUNT; i += 2)
+                reservations[i].write(i);
+        });
+        for(int i = 1; i < COUNT; i += 2)
+            reservations[i].write(i);
+        t.join();
+
+        for(int i = COUNT - 1; i >= 0; --i)
+            appender.commit(reservations[i]);
+
+        auto tailer = chronicle.create_tailer();
+        for(int i = COUNT - 1; i >= 0; --i)
+        {
+            REQUIRE(tailer.next_index());
+            REQUIRE(tailer.read<std::int32_t>() == i);
+        }
+        REQUIRE(!tailer.next_index());
+    }
+
+    SECTION("Data file resumption skips reservations")
+    {
+        auto committed = appender.reserve(64);
+        auto abandoned = appender.reserve(64);
+        committed.write(1);
+        appender.commit(committed);
+        write_test_data(appender, 0, 1);
+
+        auto name = DATA_FILE_NAME_PREFIX + std::to_string(util::get_native_thread_id()) + "-0";
+        region r((path() / fs::directory_iterator(path())->path().filename() / name).string(), 1 << 20, 0);
+        // 2 * (4 + 64) + (4 + 36)
+        REQUIRE(vanilla_data::find_data_end(r, 0) == 176);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Claiming fixed writer ids", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    vanilla_chronicle chronicle(settings);
+    const auto writer_id = test_writer_id(chronicle, 0);
+
+    SECTION("Out of the range")
+    {
+        // The native thread ids are below
+        REQUIRE_THROWS_AS(chronicle.create_appender(chronicle.first_writer_id() - 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(chronicle.create_appender(1 << WRITER_ID_BITS), std::invalid_argument);
+    }
+
+    SECTION("One appender at a time")
+    {
+        auto appender = chronicle.create_appender(writer_id);
+        REQUIRE_THROWS_AS(chronicle.create_appender(writer_id), std::runtime_error);
+        // Another chronicle - as another process would have
+        vanilla_chronicle other(settings);
+        REQUIRE_THROWS_AS(other.create_appender(writer_id), std::runtime_error);
+        auto moved = std::move(appender);
+        REQUIRE_THROWS_AS(other.create_appender(writer_id), std::runtime_error);
+    }
+
+    SECTION("Released with the appender")
+    {
+        {
+            auto appender = chronicle.create_appender(writer_id);
+            write_test_data(appender, 0, 1);
+        }
+        auto appender = chronicle.create_appender(writer_id);
+        write_test_data(appender, 1, 1);
+        REQUIRE(appender.index() >= 0);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reading excerpts in batches", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 16);
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto THREAD_COUNT = 3u;
+    constexpr auto ITER_COUNT = 3000u;
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        // Interleave the writers
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+                write_test_data(*appenders[(tid + i) % THREAD_COUNT], (tid + i) % THREAD_COUNT, 1);
+    }
+
+    auto tailer = chronicle.create_tailer();
+    auto batch_tailer = chronicle.create_tailer();
+    REQUIRE(batch_tailer.next_batch(0).empty());
+
+    std::size_t total = 0;
+    while(true)
+    {
+        auto batch = batch_tailer.next_batch(100);
+        if(batch.empty())
+            break;
+        REQUIRE(batch.size() <= 100);
+        // A batch never crosses an index file
+        REQUIRE((batch.front().index >> 10) == (batch.back().index >> 10));
+        for(auto && view : batch)
+        {
+            REQUIRE(tailer.next_index());
+            REQUIRE(view.index == tailer.index());
+            REQUIRE(view.length == tailer.limit());
+            REQUIRE(std::memcmp(view.data, tailer.buffer().data(), static_cast<std::size_t>(view.length)) == 0);
+        }
+        REQUIRE(batch_tailer.index() == batch.back().index);
+        REQUIRE(batch_tailer.read<std::int32_t>() == tailer.read<std::int32_t>());
+        total += batch.size();
+    }
+    REQUIRE(total == THREAD_COUNT * ITER_COUNT);
+    REQUIRE(!tailer.next_index());
+
+    // The regular interface continues after a batch
+    auto mixed = chronicle.create_tailer();
+    REQUIRE(mixed.next_batch(10).size() == 10);
+    REQUIRE(mixed.next_index());
+    const auto after_batch = mixed.index();
+    REQUIRE(after_batch == mixed.to_start().index() + 11);
+
+    // A moved tailer keeps its position and batch
+    const auto batch_end = mixed.next_batch(10).back().index;
+    auto moved = std::move(mixed);
+    REQUIRE(moved.index() == batch_end);
+    REQUIRE(moved.buffer().index() == batch_end);
+    REQUIRE(moved.batch_regions().size() >= 1);
+    REQUIRE(moved.next_index());
+    REQUIRE(moved.index() == batch_end + 1);
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reading with data prefetching", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 16);
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto THREAD_COUNT = 6u;
+    constexpr auto ITER_COUNT = 1000u;
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+                write_test_data(*appenders[(tid * 7 + i) % THREAD_COUNT], (tid * 7 + i) % THREAD_COUNT, 1);
+    }
+
+    auto reference = chronicle.create_tailer();
+    REQUIRE(reference.prefetch_distance() == 4);
+    reference.prefetch_distance(0);
+
+    // More data files than remembered regions and distances crossing the index files
+    for(auto distance : {1, 4, 16, 2000})
+    {
+        auto tailer = chronicle.create_tailer();
+        tailer.prefetch_distance(distance);
+        reference.to_start();
+        auto count = 0u;
+        while(tailer.next_index())
+        {
+            REQUIRE(reference.next_index());
+            REQUIRE(tailer.index() == reference.index());
+            REQUIRE(tailer.limit() == reference.limit());
+            REQUIRE(std::memcmp(tailer.buffer().data(), reference.buffer().data(), static_cast<std::size_t>(tailer.limit())) == 0);
+            ++count;
+        }
+        REQUIRE(count == THREAD_COUNT * ITER_COUNT);
+        REQUIRE(!reference.next_index());
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reading the index without the data", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 16);
+    settings.index_block_size(1ULL << 13);
+
+    constexpr auto THREAD_COUNT = 3u;
+    constexpr auto ITER_COUNT = 1000u;
+    {
+        vanilla_chronicle chronicle(settings);
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+                write_test_data(*appenders[tid], tid, 1);
+    }
+
+    vanilla_chronicle chronicle(settings);
+    auto tailer = chronicle.create_tailer();
+    auto lazy = chronicle.create_tailer();
+    REQUIRE(!lazy.lazy_data());
+    lazy.lazy_data(true);
+
+    SECTION("The data is loaded on first access")
+    {
+        for(auto i = 0u; i != THREAD_COUNT * ITER_COUNT; ++i)
+        {
+            REQUIRE(tailer.next_index());
+            REQUIRE(lazy.next_index());
+            REQUIRE(lazy.index() == tailer.index());
+            REQUIRE(lazy.writer_id() == test_writer_id(chronicle, i % THREAD_COUNT));
+            REQUIRE(lazy.writer_id() == tailer.writer_id());
+            REQUIRE(lazy.data_file_number() == tailer.data_file_number());
+            REQUIRE(lazy.data_offset() == tailer.data_offset());
+            if(i % 7 == 0)
+            {
+                REQUIRE(lazy.limit() == tailer.limit());
+                REQUIRE(lazy.read<std::int32_t>() == tailer.read<std::int32_t>());
+            }
+        }
+        REQUIRE(!lazy.next_index());
+    }
+
+    SECTION("Without the data files")
+    {
+        std::vector<fs::path> data_files;
+        for(fs::recursive_directory_iterator it(path()), end; it != end; ++it)
+        {
+            if(it->path().filename().string().compare(0, 5, "data-") == 0)
+                data_files.push_back(it->path());
+        }
+        REQUIRE(!data_files.empty());
+        for(auto && data_file : data_files)
+            fs::remove(data_file);
+
+        auto count = 0u;
+        while(lazy.next_index())
+        {
+            REQUIRE(lazy.writer_id() == test_writer_id(chronicle, count % THREAD_COUNT));
+            ++count;
+        }
+        REQUIRE(count == THREAD_COUNT * ITER_COUNT);
+        REQUIRE_THROWS_AS(lazy.buffer(), std::runtime_error);
+        REQUIRE(!tailer.next_index());
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reading the excerpts of selected writers", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 16);
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto THREAD_COUNT = 4u;
+    constexpr auto ITER_COUNT = 2000u;
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        // The fourth writer only writes now and then - long runs of other writers in between
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+                if(tid != 3 || i % 300 == 0)
+                    write_test_data(*appenders[tid], tid, 1);
+    }
+
+    auto tailer = chronicle.create_tailer();
+    REQUIRE_THROWS_AS(tailer.writer_filter({1 << WRITER_ID_BITS}), std::invalid_argument);
+
+    SECTION("A rare writer")
+    {
+        tailer.writer_filter({test_writer_id(chronicle, 3)});
+        auto count = 0u;
+        while(tailer.next_index())
+        {
+            REQUIRE(tailer.writer_id() == test_writer_id(chronicle, 3));
+            REQUIRE(tailer.read<std::int32_t>() == 3);
+            ++count;
+        }
+        REQUIRE(count == (ITER_COUNT + 299) / 300);
+    }
+
+    SECTION("Several writers")
+    {
+        tailer.writer_filter({test_writer_id(chronicle, 0), test_writer_id(chronicle, 2)});
+        auto reference = chronicle.create_tailer();
+        auto count = 0u;
+        while(tailer.next_index())
+        {
+            do
+                REQUIRE(reference.next_index());
+            while(reference.writer_id() != test_writer_id(chronicle, 0) && reference.writer_id() != test_writer_id(chronicle, 2));
+            REQUIRE(tailer.index() == reference.index());
+            ++count;
+        }
+        REQUIRE(count == 2 * ITER_COUNT);
+    }
+
+    SECTION("In batches")
+    {
+        tailer.writer_filter({test_writer_id(chronicle, 1)});
+        auto count = 0u;
+        while(true)
+        {
+            auto batch = tailer.next_batch(64);
+            if(batch.empty())
+                break;
+            for(auto && view : batch)
+            {
+                std::int32_t id;
+                std::memcpy(&id, view.data, sizeof(id));
+                REQUIRE(id == 1);
+            }
+            count += static_cast<std::uint32_t>(batch.size());
+        }
+        REQUIRE(count == ITER_COUNT);
+    }
+
+    SECTION("Removing the filter")
+    {
+        tailer.writer_filter({test_writer_id(chronicle, 3)});
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.next_index());
+        const auto second = tailer.index();
+        tailer.writer_filter({});
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == second + 1);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Tailing over a gap of empty cycles", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    vanilla_chronicle chronicle(settings);
+    constexpr auto ITER_COUNT = 100u;
+    {
+        auto appender = chronicle.create_appender();
+        write_test_data(appender, 1, ITER_COUNT);
+    }
+
+    // Make copies of today's cycle a year and a month ago
+    const auto today = cycle_for_now(settings.cycle_length());
+    const auto today_path = path() / settings.cycle_format().date_from_cycle(today);
+    for(auto cycle : {today - 400, today - 30})
+    {
+        const auto cycle_path = path() / settings.cycle_format().date_from_cycle(cycle);
+        fs::create_directories(cycle_path);
+        for(fs::directory_iterator it(today_path), end; it != end; ++it)
+            fs::copy_file(it->path(), cycle_path / it->path().filename());
+    }
+
+    auto tailer = chronicle.create_tailer();
+    std::vector<std::int64_t> cycles;
+    auto count = 0u;
+    while(tailer.next_index())
+    {
+        const auto cycle = tailer.index() / settings.entries_per_cycle();
+        if(cycles.empty() || cycles.back() != cycle)
+            cycles.push_back(cycle);
+        REQUIRE(tailer.read<std::uint32_t>() == 1);
+        ++count;
+    }
+    REQUIRE(count == 3 * ITER_COUNT);
+    REQUIRE(cycles == (std::vector<std::int64_t>{today - 400, today - 30, today}));
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Finding the last index over several index files", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+    auto appender = chronicle.create_appender();
+    write_test_data(appender, 1, 3000);
+
+    REQUIRE(chronicle.last_index() == chronicle.last_written_index());
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(tailer.to_end().index() == chronicle.last_written_index());
+    REQUIRE(!tailer.next_index());
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Seeking by time", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    REQUIRE_THROWS_AS(vanilla_chronicle(vanilla_chronicle_settings(settings).time_index_interval(24)), std::invalid_argument);
+    settings.time_index_interval(16);
+    vanilla_chronicle chronicle(settings);
+
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(!tailer.seek_time(micros_for_now()));
+
+    constexpr auto ITER_COUNT = 5000u;
+    constexpr auto PAUSE_AT = 3000u;
+    std::vector<std::int64_t> times;
+    {
+        auto appender = chronicle.create_appender();
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+        {
+            if(i == PAUSE_AT)
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            times.push_back(micros_for_now());
+            appender.start_excerpt(8);
+            appender.write(times.back());
+            appender.finish();
+        }
+    }
+    const auto first = chronicle.create_tailer().to_start().index() + 1;
+    auto timestamp_of = [](excerpt_tailer & t) { return t.read<std::int64_t>(); };
+
+    SECTION("Using the time index")
+    {
+        REQUIRE(tailer.seek_time(times[PAUSE_AT]));
+        const auto found = tailer.index() - first;
+        // Narrowed down to the entries recorded around the pause...
+        REQUIRE(found > PAUSE_AT - 32);
+        // ...and never past an excerpt written at or after the time
+        REQUIRE(found <= PAUSE_AT);
+
+        REQUIRE(tailer.seek_time(times[PAUSE_AT], timestamp_of));
+        REQUIRE(tailer.index() == first + PAUSE_AT);
+        REQUIRE(tailer.read<std::int64_t>() == times[PAUSE_AT]);
+    }
+
+    SECTION("Before and after")
+    {
+        REQUIRE(tailer.seek_time(times.front() - 1000));
+        REQUIRE(tailer.index() == first);
+        REQUIRE(!tailer.seek_time(times.back() + 1, timestamp_of));
+    }
+
+    SECTION("Without the time index files")
+    {
+        vanilla_chronicle_settings no_time_settings(path().c_str());
+        no_time_settings.index_block_size(1ULL << 13);
+        vanilla_chronicle no_time_chronicle(no_time_settings);
+        auto no_time_tailer = no_time_chronicle.create_tailer();
+        REQUIRE(no_time_tailer.seek_time(times[PAUSE_AT]));
+        REQUIRE(no_time_tailer.index() == first);
+        REQUIRE(no_time_tailer.seek_time(times[PAUSE_AT], timestamp_of));
+        REQUIRE(no_time_tailer.index() == first + PAUSE_AT);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Seeking by a monotonic key", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    auto key_of = [](excerpt_tailer & t) { return t.read<std::int64_t>(); };
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(!tailer.seek_by_key(key_of, INT64_C(0)));
+
+    // Even keys 0, 2, 4... over several index files
+    constexpr auto ITER_COUNT = 3000;
+    {
+        auto appender = chronicle.create_appender();
+        for(std::int64_t i = 0; i != ITER_COUNT; ++i)
+        {
+            appender.start_excerpt(8);
+            appender.write(2 * i);
+            appender.finish();
+        }
+    }
+    const auto first = chronicle.create_tailer().to_start().index() + 1;
+
+    SECTION("Within the index files")
+    {
+        for(std::int64_t key : {0, 1, 2, 100, 2046, 2047, 2048, 2049, 4000, 5998})
+        {
+            REQUIRE(tailer.seek_by_key(key_of, key));
+            REQUIRE(tailer.index() == first + (key + 1) / 2);
+            REQUIRE(tailer.read<std::int64_t>() == (key + 1) / 2 * 2);
+        }
+        REQUIRE(tailer.seek_by_key(key_of, INT64_C(-5)));
+        REQUIRE(tailer.index() == first);
+    }
+
+    SECTION("Past the end")
+    {
+        REQUIRE(tailer.seek_by_key(key_of, INT64_C(100)));
+        REQUIRE(!tailer.seek_by_key(key_of, INT64_C(5999)));
+        // The tailer stays where it was
+        REQUIRE(tailer.index() == first + 50);
+        REQUIRE(tailer.read<std::int64_t>() == 100);
+    }
+
+    SECTION("Over several cycles")
+    {
+        // Move today's cycle a year back and add a bit more today
+        const auto today = cycle_for_now(settings.cycle_length());
+        const auto old_cycle = today - 365;
+        const auto today_path = path() / settings.cycle_format().date_from_cycle(today);
+        fs::rename(today_path, path() / settings.cycle_format().date_from_cycle(old_cycle));
+        fs::create_directories(path() / settings.cycle_format().date_from_cycle(today - 100));
+        vanilla_chronicle moved(settings);
+        {
+            auto appender = moved.create_appender();
+            for(std::int64_t i = ITER_COUNT; i != ITER_COUNT + 10; ++i)
+            {
+                appender.start_excerpt(8);
+                appender.write(2 * i);
+                appender.finish();
+            }
+        }
+        auto moved_tailer = moved.create_tailer();
+        const auto old_start = static_cast<std::int64_t>(old_cycle) * settings.entries_per_cycle();
+        const auto today_start = static_cast<std::int64_t>(today) * settings.entries_per_cycle();
+        REQUIRE(moved_tailer.seek_by_key(key_of, INT64_C(3001)));
+        REQUIRE(moved_tailer.index() == old_start + 1501);
+        REQUIRE(moved_tailer.seek_by_key(key_of, INT64_C(5999)));
+        REQUIRE(moved_tailer.index() == today_start);
+        REQUIRE(moved_tailer.seek_by_key(key_of, INT64_C(6004)));
+        REQUIRE(moved_tailer.index() == today_start + 2);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Reading backwards", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(!tailer.prev_index());
+
+    constexpr auto ITER_COUNT = 2500u;
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != 2; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            write_test_data(*appenders[i % 2], i % 2, 1);
+    }
+
+    SECTION("Over the index files")
+    {
+        std::vector<std::int64_t> forward;
+        auto reference = chronicle.create_tailer();
+        while(reference.next_index())
+            forward.push_back(reference.index());
+
+        std::vector<std::int64_t> backward;
+        while(tailer.prev_index())
+        {
+            backward.push_back(tailer.index());
+            REQUIRE(tailer.read<std::uint32_t>() == (forward.size() - backward.size()) % 2);
+        }
+        std::reverse(backward.begin(), backward.end());
+        REQUIRE(backward == forward);
+        // Stays on the first one
+        REQUIRE(tailer.index() == forward.front());
+
+        // Back and forth
+        REQUIRE(tailer.index(forward[1024]));
+        REQUIRE(tailer.prev_index());
+        REQUIRE(tailer.index() == forward[1023]);
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.index() == forward[1025]);
+    }
+
+    SECTION("With a writer filter")
+    {
+        tailer.writer_filter({test_writer_id(chronicle, 1)});
+        auto count = 0u;
+        while(tailer.prev_index())
+        {
+            REQUIRE(tailer.writer_id() == test_writer_id(chronicle, 1));
+            ++count;
+        }
+        REQUIRE(count == ITER_COUNT / 2);
+    }
+
+    SECTION("Over the cycles")
+    {
+        const auto today = cycle_for_now(settings.cycle_length());
+        const auto today_path = path() / settings.cycle_format().date_from_cycle(today);
+        const auto old_path = path() / settings.cycle_format().date_from_cycle(today - 10);
+        fs::create_directories(old_path);
+        for(fs::directory_iterator it(today_path), end; it != end; ++it)
+            fs::copy_file(it->path(), old_path / it->path().filename());
+        fs::create_directories(path() / settings.cycle_format().date_from_cycle(today - 5));
+
+        auto count = 0u;
+        std::int64_t last = std::numeric_limits<std::int64_t>::max();
+        while(tailer.prev_index())
+        {
+            REQUIRE(tailer.index() < last);
+            last = tailer.index();
+            ++count;
+        }
+        REQUIRE(count == 2 * ITER_COUNT);
+        REQUIRE(last == static_cast<std::int64_t>(today - 10) * settings.entries_per_cycle());
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Fetching many excerpts at once", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    settings.data_block_size(1ULL << 16);
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+
+    constexpr auto THREAD_COUNT = 3u;
+    constexpr auto ITER_COUNT = 1000u;
+    {
+        std::vector<std::unique_ptr<excerpt_appender>> appenders;
+        for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+            appenders.emplace_back(new excerpt_appender(chronicle, test_writer_id(chronicle, tid)));
+        for(auto i = 0u; i != ITER_COUNT; ++i)
+            for(auto tid = 0u; tid != THREAD_COUNT; ++tid)
+                write_test_data(*appenders[tid], tid, 1);
+    }
+
+    const auto first = chronicle.create_tailer().to_start().index() + 1;
+    // Shuffled, repeated and missing ones
+    std::vector<std::int64_t> indices;
+    for(auto i = 0u; i < THREAD_COUNT * ITER_COUNT; i += 7)
+        indices.push_back(first + (i * 1031) % (THREAD_COUNT * ITER_COUNT));
+    indices.push_back(first + 5);
+    indices.push_back(first + 5);
+    indices.push_back(first + THREAD_COUNT * ITER_COUNT);
+    indices.push_back(-1);
+
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(tailer.next_index());
+    auto reference = chronicle.create_tailer();
+    auto views = tailer.multi_get(indices);
+    REQUIRE(views.size() == indices.size());
+    for(std::size_t i = 0; i != indices.size(); ++i)
+    {
+        REQUIRE(views[i].index == indices[i]);
+        if(i >= indices.size() - 2)
+        {
+            REQUIRE(views[i].data == nullptr);
+            continue;
+        }
+        REQUIRE(reference.index(indices[i]));
+        REQUIRE(views[i].length == reference.limit());
+        REQUIRE(std::memcmp(views[i].data, reference.buffer().data(), static_cast<std::size_t>(views[i].length)) == 0);
+    }
+
+    // Still where it was
+    REQUIRE(tailer.index() == first);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.index() == first + 1);
+    REQUIRE(tailer.multi_get({}).empty());
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Waiting for excerpts written in the same process", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    vanilla_chronicle chronicle(settings);
+    auto appender = chronicle.create_appender();
+    auto write = [](excerpt_appender & a, std::int32_t value)
+    {
+        a.start_excerpt(4);
+        a.write(value);
+        a.finish();
+    };
+    // Written before this process "started"
+    {
+        vanilla_chronicle earlier(settings);
+        auto earlier_appender = earlier.create_appender(test_writer_id(earlier, 1));
+        write(earlier_appender, 0);
+    }
+
+    auto tailer = chronicle.create_tailer();
+    tailer.same_process_writers(true);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 0);
+    REQUIRE(!tailer.next_index());
+
+    write(appender, 1);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 1);
+    REQUIRE(!tailer.next_index());
+
+    // The watermark is shared by all the chronicle objects of this process opened at the same path
+    {
+        vanilla_chronicle_settings same_path((path() / ".").c_str());
+        same_path.thread_id_bits(WRITER_ID_BITS);
+        vanilla_chronicle same_process(same_path);
+        auto same_process_appender = same_process.create_appender(test_writer_id(same_process, 3));
+        write(same_process_appender, 2);
+    }
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 2);
+    REQUIRE(!tailer.next_index());
+
+    // Only the watermark of this process is looked at - a write from another process goes unnoticed
+    const auto child = ::fork();
+    REQUIRE(child >= 0);
+    if(child == 0)
+    {
+        vanilla_chronicle other(settings);
+        auto other_appender = other.create_appender(test_writer_id(other, 2));
+        write(other_appender, 3);
+        ::_exit(0);
+    }
+    int status = -1;
+    REQUIRE(::waitpid(child, &status, 0) == child);
+    REQUIRE(status == 0);
+    REQUIRE(!tailer.next_index());
+    REQUIRE(chronicle.create_tailer().to_end().read<std::int32_t>() == 3);
+    write(appender, 4);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 3);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 4);
+
+    SECTION("Waiting with an idle strategy")
+    {
+        REQUIRE(!tailer.wait_next_index(1000));
+        REQUIRE(!tailer.wait_next_index(1000, util::sleep_idle(100)));
+
+        std::thread writer([&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            auto a = chronicle.create_appender();
+            write(a, 5);
+        });
+        REQUIRE(tailer.wait_next_index(-1, util::yield_idle()));
+        REQUIRE(tailer.read<std::int32_t>() == 5);
+        writer.join();
+    }
+
+    SECTION("Moving the tailer back")
+    {
+        REQUIRE(tailer.index(tailer.index() - 1));
+        REQUIRE(tailer.next_index());
+        REQUIRE(tailer.read<std::int32_t>() == 4);
+        tailer.same_process_writers(false);
+        REQUIRE(!tailer.wait_next_index(0, util::busy_spin_idle()));
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Watching the shared header", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.thread_id_bits(WRITER_ID_BITS);
+    REQUIRE_THROWS_AS(vanilla_chronicle(settings).create_tailer().block_next_index(0), std::logic_error);
+    settings.shared_header(true);
+    vanilla_chronicle chronicle(settings);
+    // Another process writing
+    vanilla_chronicle other(settings);
+    auto write = [&other](std::int32_t value)
+    {
+        auto appender = other.create_appender(test_writer_id(other, 2));
+        appender.start_excerpt(4);
+        appender.write(value);
+        appender.finish();
+    };
+
+    auto * header = chronicle.header();
+    REQUIRE(header != nullptr);
+    REQUIRE(header->last_index() == -1);
+    REQUIRE(header->sequence() == 0);
+
+    auto tailer = chronicle.create_tailer();
+    REQUIRE(!tailer.next_index());
+    write(0);
+    REQUIRE(header->sequence() == 1);
+    REQUIRE(header->last_index() == other.last_written_index());
+    REQUIRE(chronicle.last_index() == other.last_written_index());
+
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 0);
+    REQUIRE(!tailer.next_index());
+    write(1);
+    REQUIRE(tailer.next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 1);
+
+    // Blocking on the header
+    REQUIRE(!tailer.block_next_index(1000));
+    std::thread writer([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        write(2);
+    });
+    REQUIRE(tailer.block_next_index());
+    REQUIRE(tailer.read<std::int32_t>() == 2);
+    writer.join();
+    REQUIRE(header->sequence() == 3);
+
+    // A writer that does not know about the header
+    settings.shared_header(false);
+    vanilla_chronicle unaware(settings);
+    REQUIRE_THROWS_AS(unaware.create_appender(), std::logic_error);
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "A reader died waiting on the shared header", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    settings.shared_header(true);
+    auto chronicle = std::unique_ptr<vanilla_chronicle>(new vanilla_chronicle(settings));
+    REQUIRE(chronicle->header()->waiters() == 0);
+
+    // The count of the waiters left behind by the dead reader
+    {
+        std::fstream file((path() / HEADER_FILE_NAME).string(), std::ios::in | std::ios::out | std::ios::binary);
+        const std::int32_t leaked = 1;
+        file.seekp(8);
+        file.write(reinterpret_cast<const char *>(&leaked), sizeof(leaked));
+    }
+    REQUIRE(chronicle->header()->waiters() == 1);
+
+    // Kept while somebody else uses the header - a reader might be waiting
+    {
+        vanilla_chronicle another(settings);
+        REQUIRE(another.header()->waiters() == 1);
+    }
+
+    // Reset by the only user
+    chronicle.reset();
+    vanilla_chronicle reopened(settings);
+    REQUIRE(reopened.header()->waiters() == 0);
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Bounding the lead over the slowest consumer", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    vanilla_chronicle chronicle(settings);
+    auto appender = chronicle.create_appender();
+    auto write = [&appender](std::int32_t value)
+    {
+        if(!appender.start_excerpt(4))
+            return false;
+        appender.write(value);
+        appender.finish();
+        return true;
+    };
+
+    // No consumers - no bound
+    appender.max_lead(5, excerpt_appender::lead_policy::drop);
+    for(auto i = 0; i != 10; ++i)
+        REQUIRE(write(i));
+
+    auto tailer = chronicle.create_tailer();
+    for(auto i = 0; i != 8; ++i)
+        REQUIRE(tailer.next_index());
+    tailer.checkpoint("consumer");
+    REQUIRE(chronicle.excerpts_between(tailer.index(), chronicle.last_written_index()) == 2);
+
+    SECTION("Dropping")
+    {
+        REQUIRE(write(10));
+        REQUIRE(write(11));
+        REQUIRE(write(12));
+        REQUIRE(!write(13));
+        REQUIRE(appender.dropped() == 1);
+        // Nothing to write into
+        REQUIRE(appender.buffer().data() == nullptr);
+        REQUIRE(tailer.next_index());
+        tailer.checkpoint("consumer");
+        REQUIRE(write(13));
+        REQUIRE(!write(14));
+        REQUIRE(appender.dropped() == 2);
+        // Removing the bound
+        appender.max_lead(0);
+        REQUIRE(write(14));
+    }
+
+    SECTION("Asking the callback")
+    {
+        std::vector<std::int64_t> leads;
+        auto allow = true;
+        appender.max_lead(3, excerpt_appender::lead_policy::callback, [&](std::int64_t lead)
+        {
+            leads.push_back(lead);
+            return allow;
+        });
+        REQUIRE(write(10));
+        REQUIRE(write(11));
+        allow = false;
+        REQUIRE(!write(12));
+        REQUIRE(leads == (std::vector<std::int64_t>{3, 4}));
+        REQUIRE_THROWS_AS(appender.max_lead(3, excerpt_appender::lead_policy::callback), std::invalid_argument);
+    }
+
+    SECTION("Blocking until the consumer catches up")
+    {
+        for(auto policy : {excerpt_appender::lead_policy::block, excerpt_appender::lead_policy::spin})
+        {
+            appender.max_lead(3, policy);
+            while(chronicle.excerpts_between(tailer.index(), chronicle.last_written_index()) < 3)
+                REQUIRE(write(0));
+
+            std::atomic<bool> consumed(false);
+            std::atomic<bool> moved(false);
+            std::thread consumer([&]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                consumed = true;
+                moved = tailer.next_index();
+                tailer.checkpoint("consumer");
+            });
+            REQUIRE(write(1));
+            REQUIRE(consumed);
+            consumer.join();
+            REQUIRE(moved);
+        }
+        REQUIRE(appender.dropped() == 0);
+    }
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Counting the excerpts between two indices", "[vanilla_chronicle]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    // 1024 entries per index file
+    settings.index_block_size(1ULL << 13);
+    vanilla_chronicle chronicle(settings);
+    constexpr auto ITER_COUNT = 1500u;
+    {
+        auto appender = chronicle.create_appender();
+        write_test_data(appender, 1, ITER_COUNT);
+    }
+
+    // Make copies of today's cycle a month and a day ago
+    const auto today = cycle_for_now(settings.cycle_length());
+    const auto today_path = path() / settings.cycle_format().date_from_cycle(today);
+    for(auto cycle : {today - 30, today - 1})
+    {
+        const auto cycle_path = path() / settings.cycle_format().date_from_cycle(cycle);
+        fs::create_directories(cycle_path);
+        for(fs::directory_iterator it(today_path), end; it != end; ++it)
+            fs::copy_file(it->path(), cycle_path / it->path().filename());
+    }
+
+    auto index_of = [&settings](std::int32_t cycle, std::int64_t entry) { return cycle * settings.entries_per_cycle() + entry; };
+    REQUIRE(chronicle.excerpts_between(index_of(today, 10), index_of(today, 1200)) == 1190);
+    REQUIRE(chronicle.excerpts_between(index_of(today - 1, 1000), index_of(today, 19)) == 499 + 20);
+    REQUIRE(chronicle.excerpts_between(index_of(today - 30, 49), index_of(today, 19)) == 1450 + ITER_COUNT + 20);
+}
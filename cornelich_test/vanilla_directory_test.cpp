@@ -0,0 +1,103 @@
+/*
+Copyright 2015-2016 Joanna Hulboj <j@hulboj.org>
+Copyright 2016 Milosz Hulboj <m@hulboj.org>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <cornelich/util/test_helpers.h>
+
+#include <cornelich/vanilla_chronicle_settings.h>
+#include <cornelich/vanilla_directory.h>
+#include <cornelich/vanilla_date.h>
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <catch.hpp>
+
+using namespace cornelich;
+
+namespace
+{
+
+void touch(const fs::path & path)
+{
+    fs::create_directories(path.parent_path());
+    fs::ofstream(path).put('x');
+}
+
+}
+
+TEST_CASE_METHOD(clean_up_fixture, "Caching the chronicle directory layout", "[vanilla_directory]")
+{
+    vanilla_chronicle_settings settings(path().c_str());
+    vanilla_directory directory(settings);
+    const auto & fmt = settings.cycle_format();
+
+    // Nothing there yet - not even the chronicle directory
+    REQUIRE(directory.first_cycle() == -1);
+    REQUIRE(directory.last_cycle() == -1);
+    REQUIRE(directory.next_cycle(0) == -1);
+    REQUIRE(directory.last_index_file_number(16801) == -1);
+
+    SECTION("Files created by someone else")
+    {
+        touch(path() / fmt.date_from_cycle(16801) / "index-0");
+        touch(path() / fmt.date_from_cycle(16801) / "data-7-0");
+        touch(path() / fmt.date_from_cycle(16900) / "index-0");
+        touch(path() / "not-a-cycle" / "index-3");
+
+        REQUIRE(directory.first_cycle() == 16801);
+        REQUIRE(directory.last_cycle() == 16900);
+        REQUIRE(directory.next_cycle(16801) == 16900);
+        REQUIRE(directory.next_cycle(16900) == -1);
+        REQUIRE(directory.last_index_file_number(16801) == 0);
+        REQUIRE(directory.last_data_file_number(16801, 7) == 0);
+        REQUIRE(directory.last_data_file_number(16801, 8) == -1);
+        REQUIRE(directory.last_data_file_number(16802, 7) == -1);
+
+        // Changes after the first look
+        touch(path() / fmt.date_from_cycle(16801) / "index-1");
+        touch(path() / fmt.date_from_cycle(16801) / "index-12");
+        touch(path() / fmt.date_from_cycle(16801) / "data-7-3");
+        touch(path() / fmt.date_from_cycle(16801) / "data-8-1");
+        touch(path() / fmt.date_from_cycle(16850) / "index-0");
+        REQUIRE(directory.last_index_file_number(16801) == 12);
+        REQUIRE(directory.last_data_file_number(16801, 7) == 3);
+        REQUIRE(directory.last_data_file_number(16801, 8) == 1);
+        REQUIRE(directory.next_cycle(16801) == 16850);
+
+        // Removals
+        fs::remove(path() / fmt.date_from_cycle(16801) / "index-12");
+        fs::remove_all(path() / fmt.date_from_cycle(16850));
+        REQUIRE(directory.last_index_file_number(16801) == 1);
+        REQUIRE(directory.next_cycle(16801) == 16900);
+
+        // The whole chronicle directory
+        fs::remove_all(path());
+        REQUIRE(directory.first_cycle() == -1);
+        touch(path() / fmt.date_from_cycle(16000) / "index-2");
+        REQUIRE(directory.first_cycle() == 16000);
+        REQUIRE(directory.last_index_file_number(16000) == 2);
+    }
+
+    SECTION("Files created by this process")
+    {
+        touch(path() / fmt.date_from_cycle(16801) / "index-0");
+        REQUIRE(directory.last_index_file_number(16801) == 0);
+        directory.add_index_file(16801, 1);
+        directory.add_data_file(16801, 5, 2);
+        REQUIRE(directory.last_index_file_number(16801) == 1);
+        REQUIRE(directory.last_data_file_number(16801, 5) == 2);
+    }
+}
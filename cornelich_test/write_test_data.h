@@ -18,11 +18,21 @@ limitations under the License.
 #pragma once
 
 #include <cornelich/excerpt_appender.h>
+#include <cornelich/vanilla_chronicle.h>
 #include <cstdint>
 
 using namespace cornelich;
 
-auto do_nothing = [](){};
+/// The thread id bits of the tests with fixed writer ids - leaves room for them above any pid_max
+static constexpr std::int32_t WRITER_ID_BITS = 23;
+
+/// The n-th fixed writer id of the chronicle
+inline std::int32_t test_writer_id(const vanilla_chronicle & chronicle, std::uint32_t n)
+{
+    return chronicle.first_writer_id() + static_cast<std::int32_t>(n);
+}
+
+static auto do_nothing = [](){};
 
 template<typename T = decltype(do_nothing)>
 void write_test_data(excerpt_appender & appender, std::uint32_t id, std::uint32_t count, T post_single_append = do_nothing)